@@ -2,14 +2,39 @@
  * 2-D Board Game between computer and User.
  *
  * Code intended to run on Windows OS
+ * Build: gcc -O2 -pthread "X-O Game.c" -o xo-game
 ****************************************************/
 
+// The POSIX calls (mmap, clock_gettime, posix_madvise) are declared even in a strict -std=c11 build.
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdint.h>
 #include <ctype.h>
 #include <time.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// On x86 the batch evaluation picks SSSE3 or AVX2 kernels at run time, whatever the build targets.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BATCH_X86 1
+#endif
 
 // Constant data.
 #define PLAYER_ONE 'X'
@@ -19,130 +44,705 @@
 // Number of squares that make up that side.
 #define SIDE 7
 
-/*Implementation of the getline() function that is available in Linux/Unix */
-size_t getline(char** buffer, size_t* alloc, FILE* file)
+/*
+ * The board is stored as one 64-bit word per player (a bitboard).
+ * Each row takes STRIDE bits, one more than SIDE, so the spare bit of every row
+ * acts as a guard column: a horizontal shift that runs off an edge of the board
+ * lands on a guard bit instead of wrapping into the neighbouring row.
+*/
+#define STRIDE 8
+
+#if SIDE >= STRIDE
+#error "SIDE must leave a guard column inside each STRIDE bits."
+#endif
+
+// Bit index of the cell at row i and column j, and the way back.
+#define CELL(i, j) ((i) * STRIDE + (j))
+#define CELL_ROW(cell) ((cell) / STRIDE)
+#define CELL_COL(cell) ((cell) % STRIDE)
+
+// The bits of one row that belong to real cells.
+#define ROW_MASK ((UINT64_C(1) << SIDE) - 1)
+// The bits of the whole word that belong to real cells.
+#define BOARD_MASK (ROW_MASK * (((UINT64_C(1) << (SIDE * STRIDE)) - 1) / 0xFF))
+
+// Index of each player's bit set inside the board.
+#define X_INDEX 0
+#define O_INDEX 1
+
+// The game board: bit CELL(i, j) of pieces[p] is set when player p has a piece on row i, column j.
+typedef struct BitBoard
+{
+    uint64_t pieces[2];
+} BitBoard;
+
+// The most pieces a player can have: both players' pieces must fit on the board.
+#define MAX_PIECES ((SIDE * SIDE) / 2)
+// Every piece can slide in at most four directions.
+#define MAX_MOVES (4 * MAX_PIECES)
+
+// A move slides the piece on cell 'from' to the vacant neighbouring cell 'to'.
+typedef struct Move
+{
+    uint8_t from;
+    uint8_t to;
+} Move;
+
+// A fixed-capacity list of moves, meant to live on the caller's stack.
+typedef struct MoveList
+{
+    int count;
+    Move moves[MAX_MOVES];
+} MoveList;
+
+// Counting and scanning of set bits.
+#if defined(__GNUC__) || defined(__clang__)
+#define popCount(x) __builtin_popcountll(x)
+#define lowestBit(x) __builtin_ctzll(x)
+#else
+static inline int popCount(uint64_t x)
+{
+    x = x - ((x >> 1) & UINT64_C(0x5555555555555555));
+    x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    return (int)((x * UINT64_C(0x0101010101010101)) >> 56);
+}
+
+static inline int lowestBit(uint64_t x)
 {
-    // To prevent frequent allocations, we first allocate 32 bytes.
-    if (*alloc == 0 || (*buffer) == NULL)
+    int n = 0;
+    while (!(x & 1))
     {
-        *buffer = (char*)malloc(32 * sizeof(char));
-        *alloc = 32;
+        x >>= 1;
+        n++;
     }
-    int bytes = 0;
-    while (1)
+    return n;
+}
+#endif
+
+/*
+ * Instrumentation.
+ * A build with -DXO_PROFILE counts the calls, time and heap allocations of the hot functions, and the
+ * nodes the engines search; --profile FILE writes the counts of every turn and of the whole run.
+ * The allocations counted are those made while games are played, not the tables set up at the start.
+ * Without XO_PROFILE the PROFILE_* macros expand to nothing and none of this is compiled.
+*/
+
+// Function that returns a monotonic timestamp in nanoseconds.
+uint64_t nowNanoseconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#ifdef XO_PROFILE
+// The measured functions. The time of select_move includes the functions it calls.
+enum
+{
+    PROFILE_GENERATE_MOVES,
+    PROFILE_PIECE_MOVES,
+    PROFILE_GAME_OVER,
+    PROFILE_HEURISTIC,
+    PROFILE_SELECT_MOVE,
+    PROFILE_COUNTERS
+};
+
+static const char* const profile_names[PROFILE_COUNTERS] =
+{
+    "generate_moves", "generate_piece_moves", "is_game_over", "heuristic_score", "select_move"
+};
+
+// The running totals of one function. Search threads add to them at the same time.
+typedef struct ProfileCounter
+{
+    atomic_ullong calls;
+    atomic_ullong nanoseconds;
+    atomic_ullong allocations;
+    atomic_ullong nodes;
+} ProfileCounter;
+
+// The totals read at one moment; a turn is reported as the difference of two of these.
+typedef struct ProfileSnapshot
+{
+    unsigned long long calls[PROFILE_COUNTERS];
+    unsigned long long nanoseconds[PROFILE_COUNTERS];
+    unsigned long long allocations[PROFILE_COUNTERS];
+    unsigned long long nodes[PROFILE_COUNTERS];
+    // Heap allocations anywhere in the program, and the time the snapshot was taken.
+    unsigned long long all_allocations;
+    uint64_t taken;
+} ProfileSnapshot;
+
+// Where a measured call started.
+typedef struct ProfileScope
+{
+    uint64_t start;
+    uint64_t allocations;
+} ProfileScope;
+
+static ProfileCounter profile_counters[PROFILE_COUNTERS];
+static atomic_ullong profile_allocations;
+// Allocations made by this thread, so a call is charged only with its own.
+static _Thread_local uint64_t profile_thread_allocations;
+// The report file, whether it is JSON rather than CSV, the turns reported, and the totals at the
+// start of the run and at the end of the last turn. The lock keeps the rows of threads apart.
+static FILE* profile_file;
+static int profile_json;
+static long profile_turns;
+static ProfileSnapshot profile_start;
+static ProfileSnapshot profile_last;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Function that counts one heap allocation.
+static inline void profileAllocation(void)
+{
+    profile_thread_allocations++;
+    atomic_fetch_add_explicit(&profile_allocations, 1, memory_order_relaxed);
+}
+
+// Function that marks the start of a measured call.
+static inline ProfileScope profileBegin(void)
+{
+    ProfileScope scope = { nowNanoseconds(), profile_thread_allocations };
+    return scope;
+}
+
+// Function that charges a measured call to its counter.
+static inline void profileEnd(int counter, const ProfileScope* scope)
+{
+    ProfileCounter* c = &profile_counters[counter];
+    atomic_fetch_add_explicit(&c->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->nanoseconds, nowNanoseconds() - scope->start, memory_order_relaxed);
+    if (profile_thread_allocations != scope->allocations)
+    {
+        atomic_fetch_add_explicit(&c->allocations, profile_thread_allocations - scope->allocations, memory_order_relaxed);
+    }
+}
+
+// Function that reads all the totals.
+static void takeProfileSnapshot(ProfileSnapshot* snapshot)
+{
+    for (int i = 0; i < PROFILE_COUNTERS; i++)
+    {
+        snapshot->calls[i] = atomic_load_explicit(&profile_counters[i].calls, memory_order_relaxed);
+        snapshot->nanoseconds[i] = atomic_load_explicit(&profile_counters[i].nanoseconds, memory_order_relaxed);
+        snapshot->allocations[i] = atomic_load_explicit(&profile_counters[i].allocations, memory_order_relaxed);
+        snapshot->nodes[i] = atomic_load_explicit(&profile_counters[i].nodes, memory_order_relaxed);
+    }
+    snapshot->all_allocations = atomic_load_explicit(&profile_allocations, memory_order_relaxed);
+    snapshot->taken = nowNanoseconds();
+}
+
+// Function that writes what happened between two snapshots: a CSV row per function and one for the
+// whole interval, or a single JSON object. 'turn' is 0 for the summary of the run.
+static void writeProfile(const char* scope, long turn, const ProfileSnapshot* from, const ProfileSnapshot* to)
+{
+    unsigned long long wall = to->taken - from->taken;
+    unsigned long long allocations = to->all_allocations - from->all_allocations;
+    unsigned long long nodes = to->nodes[PROFILE_SELECT_MOVE] - from->nodes[PROFILE_SELECT_MOVE];
+    if (profile_json)
     {
-        char c = fgetc(file);
-        // The character is pushed into the buffer.
-        if (bytes < (*alloc))
+        fprintf(profile_file, "{\"scope\":\"%s\",\"turn\":%ld,\"nanoseconds\":%llu,\"allocations\":%llu,\"nodes\":%llu,\"functions\":{",
+            scope, turn, wall, allocations, nodes);
+        for (int i = 0; i < PROFILE_COUNTERS; i++)
         {
-            (*buffer)[bytes++] = c;
+            fprintf(profile_file, "%s\"%s\":{\"calls\":%llu,\"nanoseconds\":%llu,\"allocations\":%llu,\"nodes\":%llu}",
+                i ? "," : "", profile_names[i], to->calls[i] - from->calls[i], to->nanoseconds[i] - from->nanoseconds[i],
+                to->allocations[i] - from->allocations[i], to->nodes[i] - from->nodes[i]);
         }
+        fprintf(profile_file, "}}\n");
+        return;
+    }
+    for (int i = 0; i < PROFILE_COUNTERS; i++)
+    {
+        fprintf(profile_file, "%s,%ld,%s,%llu,%llu,%llu,%llu\n", scope, turn, profile_names[i], to->calls[i] - from->calls[i],
+            to->nanoseconds[i] - from->nanoseconds[i], to->allocations[i] - from->allocations[i], to->nodes[i] - from->nodes[i]);
+    }
+    fprintf(profile_file, "%s,%ld,total,,%llu,%llu,%llu\n", scope, turn, wall, allocations, nodes);
+}
+
+// Function that reports the turn just played. Several games at once share the turn numbering.
+static void profileTurn(void)
+{
+    if (profile_file == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&profile_lock);
+    ProfileSnapshot now;
+    takeProfileSnapshot(&now);
+    writeProfile("turn", ++profile_turns, &profile_last, &now);
+    profile_last = now;
+    pthread_mutex_unlock(&profile_lock);
+}
+
+// Function that writes the summary of the run and closes the report; it runs at exit.
+static void finishProfile(void)
+{
+    pthread_mutex_lock(&profile_lock);
+    ProfileSnapshot now;
+    takeProfileSnapshot(&now);
+    writeProfile("run", 0, &profile_start, &now);
+    fclose(profile_file);
+    profile_file = NULL;
+    pthread_mutex_unlock(&profile_lock);
+}
+
+// Function that starts the report on 'path': JSON lines when it ends in ".json", CSV otherwise.
+// Returns 0 if the file cannot be created.
+int openProfile(const char* path)
+{
+    profile_file = fopen(path, "w");
+    if (profile_file == NULL)
+    {
+        return 0;
+    }
+    size_t length = strlen(path);
+    profile_json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+    if (!profile_json)
+    {
+        fprintf(profile_file, "scope,turn,function,calls,nanoseconds,allocations,nodes\n");
+    }
+    takeProfileSnapshot(&profile_start);
+    profile_last = profile_start;
+    atexit(finishProfile);
+    return 1;
+}
 
-        if(bytes == (*alloc))
+#define PROFILE_BEGIN(counter) ProfileScope profile_scope = profileBegin()
+#define PROFILE_END(counter) profileEnd(counter, &profile_scope)
+#define PROFILE_NODES(counter, n) atomic_fetch_add_explicit(&profile_counters[counter].nodes, (n), memory_order_relaxed)
+#define PROFILE_ALLOCATION() profileAllocation()
+#define PROFILE_TURN() profileTurn()
+#else
+#define PROFILE_BEGIN(counter)
+#define PROFILE_END(counter)
+#define PROFILE_NODES(counter, n)
+#define PROFILE_ALLOCATION()
+#define PROFILE_TURN()
+#endif
+
+/*
+ * Buffered line input.
+ * Answers to the prompts are read a large block at a time and split into lines in place,
+ * so a script holding thousands of games costs one read() per block instead of one fgetc() per byte.
+ * A user at the keyboard is read a line at a time, since a block read would wait for input that has not been typed.
+*/
+
+// The number of bytes asked of the file by every read.
+#define READ_CHUNK 65536
+
+typedef struct
+{
+    FILE* file;
+    // The bytes read but not handed out yet are data[start..end).
+    char* data;
+    size_t capacity;
+    size_t start;
+    size_t end;
+    // Set once the file has nothing more to give.
+    int eof;
+    // Whether every read stops at the end of a line.
+    int interactive;
+} LineReader;
+
+void initLineReader(LineReader* reader, FILE* file, int interactive)
+{
+    reader->file = file;
+    reader->interactive = interactive;
+    reader->data = NULL;
+    reader->capacity = 0;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = 0;
+}
+
+void freeLineReader(LineReader* reader)
+{
+    free(reader->data);
+    reader->data = NULL;
+    reader->capacity = 0;
+}
+
+// Function that returns the next line of input without its line ending, or NULL once the input is over.
+// The line lives in the reader's buffer and stays valid until the next call.
+char* readLine(LineReader* reader)
+{
+    // Bytes of data[start..end) already searched for a newline.
+    size_t scanned = 0;
+    while (1)
+    {
+        char* line = reader->data + reader->start;
+        size_t available = reader->end - reader->start;
+        char* newline = (available > scanned) ? (char*)memchr(line + scanned, '\n', available - scanned) : NULL;
+        if (newline != NULL || (reader->eof && available > 0))
         {
-            *buffer = (char*)realloc(*buffer, (*alloc) + 32);
-            (*alloc) += 32;
+            // The last line of a file may lack its newline; the buffer always keeps a spare byte for the terminator.
+            size_t length = (newline != NULL) ? (size_t)(newline - line) : available;
+            reader->start += (newline != NULL) ? length + 1 : length;
+            // Scripts written on Windows end their lines with "\r\n".
+            if (length > 0 && line[length - 1] == '\r')
+            {
+                length--;
+            }
+            line[length] = '\0';
+            return line;
+        }
+        if (reader->eof)
+        {
+            return NULL;
         }
+        scanned = available;
 
-        if (c == '\n')
+        // The partial line is moved to the front, and the buffer grows only when one line outgrows it.
+        if (reader->start > 0)
         {
-            // Newline character.
-            break;
+            memmove(reader->data, line, available);
+            reader->start = 0;
+            reader->end = available;
+        }
+        if (reader->end + READ_CHUNK + 1 > reader->capacity)
+        {
+            size_t capacity = (reader->capacity == 0) ? READ_CHUNK + 1 : reader->capacity * 2;
+            PROFILE_ALLOCATION();
+            char* data = (char*)realloc(reader->data, capacity);
+            if (data == NULL)
+            {
+                printf("ERROR: Out of memory while reading the input. \n");
+                reader->eof = 1;
+                continue;
+            }
+            reader->data = data;
+            reader->capacity = capacity;
+        }
+        size_t bytes = 0;
+        if (!reader->interactive)
+        {
+            bytes = fread(reader->data + reader->end, 1, READ_CHUNK, reader->file);
         }
+        else if (fgets(reader->data + reader->end, READ_CHUNK + 1, reader->file) != NULL) {
+            bytes = strlen(reader->data + reader->end);
+        }
+        reader->end += bytes;
+        if (bytes == 0)
+        {
+            reader->eof = 1;
+        }
+    }
+}
+
+
+// Function that maps a player symbol to the index of its bit set.
+int playerIndex(char player_sym)
+{
+    return (player_sym == PLAYER_ONE) ? X_INDEX : O_INDEX;
+}
+
+// Function that returns the bit set of vacant cells.
+uint64_t emptyCells(const BitBoard* board)
+{
+    return BOARD_MASK & ~(board->pieces[X_INDEX] | board->pieces[O_INDEX]);
+}
+
+// Function that returns the vacant cells reachable by one orthogonal step from any of 'pieces'.
+uint64_t stepTargets(uint64_t pieces, uint64_t empty)
+{
+    return ((pieces << 1) | (pieces >> 1) | (pieces << STRIDE) | (pieces >> STRIDE)) & empty;
+}
+
+// Function that converts a position string in <row indicator><col indicator> format to a cell index.
+// Returns -1 if the position lies outside the board.
+int cellFromString(const char* pos)
+{
+    int i = tolower(pos[0]) - 'a';
+    int j = tolower(pos[1]) - '0';
+    if (i < 0 || i >= SIDE || j < 0 || j >= SIDE)
+    {
+        return -1;
     }
-    // Including the null terminator.
-    (*buffer)[bytes] = '\0';
-    return (bytes - 1);
+    return CELL(i, j);
 }
 
+// Function that writes the position string of a cell into 'out' (at least 3 bytes).
+void cellToString(int cell, char* out)
+{
+    // Row indicator character.
+    out[0] = 'a' + CELL_ROW(cell);
+    // Colum indicating numerical character.
+    out[1] = '0' + CELL_COL(cell);
+    // The null terminator for this string.
+    out[2] = 0;
+}
+
+// Function that writes a move as its two cells, e.g. "d2d3", into 'out' (at least 5 bytes).
+void formatMove(Move move, char* out)
+{
+    cellToString(move.from, out);
+    cellToString(move.to, out + 2);
+}
+
+// Function that moves the piece of a player from one cell to another.
+void movePiece(BitBoard* board, int player, int from, int to)
+{
+    board->pieces[player] ^= (UINT64_C(1) << from) | (UINT64_C(1) << to);
+}
+
+/*
+ * Random numbers.
+ * Everything random in a game (the setup and the greedy player's choices) is drawn from an
+ * explicit generator rather than the C library's rand(). The same seed gives the same games on
+ * every platform, and threads that each own a generator never share hidden state.
+*/
+typedef struct
+{
+    uint64_t state;
+} Random;
+
+// Function that advances a splitmix64 state and returns the next 64-bit random number.
+uint64_t splitMix64(uint64_t* state)
+{
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+void seedRandom(Random* rng, uint64_t seed)
+{
+    rng->state = seed;
+}
+
+uint64_t nextRandom(Random* rng)
+{
+    return splitMix64(&rng->state);
+}
+
+// Function that returns a number in [0, n). The high half of a 32x32-bit product avoids a division
+// and its bias is below 2^-25 for every n this game uses.
+int randomBelow(Random* rng, int n)
+{
+    return (int)(((nextRandom(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+// Function that picks a seed from the clock, for games that are not asked to be reproducible.
+uint64_t clockSeed(void)
+{
+    uint64_t state = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32);
+    return splitMix64(&state);
+}
 
 // Implementation of the function that initializes the board game.
-void initializeBoard(char** board, int player_pieces)
+// The first 2 * player_pieces cells of a partial Fisher-Yates shuffle are drawn: the first half
+// go to 'X' and the rest to 'O'. Each piece costs one random number, however full the board is.
+void initializeBoard(BitBoard* board, int player_pieces, Random* rng)
 {
-    // The array of players.
-    char players[2] = { PLAYER_ONE, PLAYER_TWO };
-    // Count of players. (loop counter)
-    int c = 0;
-    // First we set every character to NULL byte.
+    // The cells not drawn yet are cells[drawn..SIDE * SIDE).
+    uint8_t cells[SIDE * SIDE];
     for (int i = 0; i < SIDE; i++)
     {
         for (int j = 0; j < SIDE; j++)
         {
-            board[i][j] = 0;
+            cells[i * SIDE + j] = (uint8_t)CELL(i, j);
         }
     }
-    while (c < 2)
+    // First we clear every cell.
+    board->pieces[X_INDEX] = 0;
+    board->pieces[O_INDEX] = 0;
+    for (int drawn = 0; drawn < 2 * player_pieces; drawn++)
     {
-        // The number of player pieces placed for this player.
-        int p = 0;
-        while (p < player_pieces)
-        {
-            // This piece is placed in a random location.
-            int i = rand() % SIDE;
-            int j = rand() % SIDE;
-            if (board[i][j] == 0)
-            {
-                // The slot is vacant.
-                // We place the piece.
-                board[i][j] = players[c];
-                // Successfully placed a player.
-                p++;
-            }
-        }
-        c++;
+        // This piece is placed in a random location among the vacant ones.
+        int pick = drawn + randomBelow(rng, SIDE * SIDE - drawn);
+        uint8_t cell = cells[pick];
+        cells[pick] = cells[drawn];
+        cells[drawn] = cell;
+        board->pieces[drawn < player_pieces ? X_INDEX : O_INDEX] |= UINT64_C(1) << cell;
     }
 }
 
-// Implementation of the function that prints the board to the terminal.
-void printBoard(char** board)
+/*
+ * Terminal output.
+ * A turn is rendered into one preallocated buffer and handed to the terminal in a single write,
+ * instead of one printf() call per cell. When output goes through pipes or slow remote terminals,
+ * the number of writes costs more than the text.
+*/
+#define OUTPUT_NORMAL 0
+// Nothing but the final results.
+#define OUTPUT_QUIET 1
+// The board is drawn once at the top of the screen and each move redraws only its two cells.
+#define OUTPUT_DIFF 2
+
+// How the game is shown; set once from the command line.
+int output_mode = OUTPUT_NORMAL;
+// Whether every turn is pushed to the terminal at once. Scripted runs leave it to stdio's buffering.
+int flush_each_turn = 1;
+
+// A full turn takes well under 2 KB.
+#define RENDER_BUFFER_SIZE 16384
+
+typedef struct RenderBuffer
+{
+    size_t length;
+    char data[RENDER_BUFFER_SIZE];
+} RenderBuffer;
+
+// Function that appends formatted text to the buffer. Text that does not fit is cut off.
+void renderf(RenderBuffer* out, const char* format, ...)
+{
+    size_t room = RENDER_BUFFER_SIZE - out->length;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out->data + out->length, room, format, args);
+    va_end(args);
+    if (n > 0)
+    {
+        out->length += ((size_t)n < room) ? (size_t)n : room - 1;
+    }
+}
+
+// Function that writes the buffer to the terminal in one go and empties it.
+void flushRender(RenderBuffer* out)
+{
+    if (out->length == 0)
+    {
+        return;
+    }
+    fwrite(out->data, 1, out->length, stdout);
+    if (flush_each_turn)
+    {
+        fflush(stdout);
+    }
+    out->length = 0;
+}
+
+// Function that prints a prompt or a message for the user, unless the output is quiet.
+void printPrompt(const char* format, ...)
+{
+    if (output_mode == OUTPUT_QUIET)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+// Function that returns the character shown for a cell.
+char cellSymbol(const BitBoard* board, int cell)
+{
+    uint64_t bit = UINT64_C(1) << cell;
+    if (board->pieces[X_INDEX] & bit)
+    {
+        return PLAYER_ONE;
+    }
+    if (board->pieces[O_INDEX] & bit)
+    {
+        return PLAYER_TWO;
+    }
+    return ' ';
+}
+
+// Implementation of the function that renders the board into the buffer.
+// Each row is built character by character and appended as one string.
+void renderBoard(RenderBuffer* out, const BitBoard* board)
 {
     // Printing the column numbers.
-    printf("  ");
+    char line[4 * SIDE + 4];
+    int n = 0;
+    line[n++] = ' ';
+    line[n++] = ' ';
     for (int j = 0; j < SIDE; j++)
     {
-        printf("%2c ", '0' + j);
+        line[n++] = ' ';
+        line[n++] = '0' + j;
+        line[n++] = ' ';
     }
+    line[n] = 0;
     // The board rows follow next line.
-    printf("\n");
+    renderf(out, "%s\n", line);
 
     for (int i = 0; i < SIDE; i++)
     {
         // The row indicator.
         // Because of ASCII encoding we get the row indicating letters in order.
-        printf("%-2c", 'a' + i);
+        n = 0;
+        line[n++] = 'a' + i;
+        line[n++] = ' ';
         for (int j = 0; j < SIDE; j++)
         {
-            if (board[i][j] != 0)
-            {
-                printf("%2c ", board[i][j]);
-            }
-            else {
-                printf("%2c ", ' ');
-            }
+            line[n++] = ' ';
+            line[n++] = cellSymbol(board, CELL(i, j));
+            line[n++] = ' ';
         }
-        printf("\n");
+        line[n] = 0;
+        renderf(out, "%s\n", line);
+    }
+}
+
+// Implementation of the function that prints the board to the terminal.
+void printBoard(const BitBoard* board)
+{
+    RenderBuffer out;
+    out.length = 0;
+    renderBoard(&out, board);
+    flushRender(&out);
+}
+
+// The screen line of the board's column header in diff mode; rows follow below it.
+#define DIFF_TOP_LINE 1
+// The first screen line below the board, where all other text scrolls.
+#define DIFF_TEXT_LINE (DIFF_TOP_LINE + SIDE + 2)
+
+// Function that clears the screen, draws the board at the top and keeps all further text
+// scrolling below it, so the board stays where the cell updates expect it.
+void renderDiffSetup(RenderBuffer* out, const BitBoard* board)
+{
+    renderf(out, "\x1b[2J\x1b[%d;1H", DIFF_TOP_LINE);
+    renderBoard(out, board);
+    renderf(out, "\x1b[%d;r\x1b[%d;1H", DIFF_TEXT_LINE, DIFF_TEXT_LINE);
+}
+
+// Function that redraws the two cells a move changed, leaving the cursor where it was.
+void renderDiffMove(RenderBuffer* out, const BitBoard* board, Move move)
+{
+    int cells[2] = { move.from, move.to };
+    renderf(out, "\x1b" "7");
+    for (int k = 0; k < 2; k++)
+    {
+        // Row i sits one line below the column header, and column j starts at screen column 3 * j + 4.
+        renderf(out, "\x1b[%d;%dH%c", DIFF_TOP_LINE + 1 + CELL_ROW(cells[k]), 3 * CELL_COL(cells[k]) + 4,
+            cellSymbol(board, cells[k]));
     }
+    renderf(out, "\x1b" "8");
+}
+
+// Function that gives the whole screen back to normal scrolling at the end of a diff mode game.
+void renderDiffTeardown(RenderBuffer* out)
+{
+    renderf(out, "\x1b[r\x1b[999;1H\n");
 }
 
 /* Implementation of the function to check if a chosen player position is valid. */
-// The first arg is the board 2D array.
+// The first arg is the board.
 // The second arg is the player symbol.
 // The third arg is the position entered in string form.
-int isChosenPositionValid(char** board, char player_sym, char* pos)
+int isChosenPositionValid(const BitBoard* board, char player_sym, char* pos)
 {
-    int i = tolower(pos[0]) - 'a';
-    int j = tolower(pos[1]) - '0';
-    if (i < 0 || i >= SIDE)
+    int cell = cellFromString(pos);
+    if (cell < 0)
     {
-        // Invalid row.
+        // Invalid row or column.
         return 0;
     }
-    if (j < 0 || j >= SIDE)
-    {
-        // Invalid column.
-        return 0;
-    }
-    if (board[i][j] != player_sym)
+    if (!(board->pieces[playerIndex(player_sym)] & (UINT64_C(1) << cell)))
     {
         // This position is either empty or occupied by another player.
         // This is invalid.
@@ -152,159 +752,76 @@ int isChosenPositionValid(char** board, char player_sym, char* pos)
     return 1;
 }
 
-// Function that helps in free()-ing a NULL pointer terminated array of strings.
-void freeArray(char** list)
+// Function that appends every move whose destinations are in 'targets', reached by adding 'delta' to the origin cell.
+void appendMoves(MoveList* list, uint64_t targets, int delta)
 {
-    if (!list)
-    {
-        return;
-    }
-    // Traversing the list of strings.
-    for (char** l = list; *l != NULL; l++)
+    while (targets)
     {
-        free(*l);
+        int to = lowestBit(targets);
+        list->moves[list->count].from = (uint8_t)(to - delta);
+        list->moves[list->count].to = (uint8_t)to;
+        list->count++;
+        targets &= targets - 1;
     }
-    free(list);
 }
 
-// Function that helps in counting the strings inside a null terminated array of strings.
-int countPosStrings(char** list)
+// Function that fills 'list' with every valid move of a player (one entry per piece and destination).
+// Nothing is allocated: the list is provided by the caller.
+void generateMoves(const BitBoard* board, int player, MoveList* list)
 {
-    int count = 0;
-    // Traversing the list of strings.
-    for (char** l = list; *l != NULL; l++)
-    {
-        count++;
-    }
-    return count;
+    PROFILE_BEGIN(PROFILE_GENERATE_MOVES);
+    uint64_t pieces = board->pieces[player];
+    uint64_t empty = emptyCells(board);
+    list->count = 0;
+    // One shift per direction: up, down, left and right.
+    appendMoves(list, (pieces >> STRIDE) & empty, -STRIDE);
+    appendMoves(list, (pieces << STRIDE) & empty, STRIDE);
+    appendMoves(list, (pieces >> 1) & empty, -1);
+    appendMoves(list, (pieces << 1) & empty, 1);
+    PROFILE_END(PROFILE_GENERATE_MOVES);
 }
 
-
-// Function that returns an array of strings representing the positions of a player.
-char** getPlayerPositions(char** board, char player_sym)
+// Function that fills 'list' with the valid moves of the single piece on 'cell'.
+void generatePieceMoves(const BitBoard* board, int cell, MoveList* list)
 {
-    int alloc = 1;
-    char** list = (char**)malloc(sizeof(char*));
-    for (int i = 0; i < SIDE; i++)
-    {
-        for (int j = 0; j < SIDE; j++)
-        {
-            if (board[i][j] == player_sym)
-            {
-                // The position of the player is stored in a char*
-                // and its pointer is stored in the list that will be returned.
-                list[alloc - 1] = (char*)malloc(sizeof(char) * 3);
-                // Row indicator character.
-                list[alloc - 1][0] = 'a' + i;
-                // Colum indicating numerical character.
-                list[alloc - 1][1] = '0' + j;
-                // The null terminator for this string.
-                list[alloc - 1][2] = 0;
-
-                // Next we grow list, so it can accomadate a future char*.
-                list = (char**)realloc(list, sizeof(char*) * (alloc + 1));
-                alloc++;
-            }
-        }
-    }
-    // The last string is set to NULL, so that the end can be marked.
-    list[alloc - 1] = NULL;
-    return list;
+    PROFILE_BEGIN(PROFILE_PIECE_MOVES);
+    uint64_t piece = UINT64_C(1) << cell;
+    uint64_t empty = emptyCells(board);
+    list->count = 0;
+    appendMoves(list, (piece >> STRIDE) & empty, -STRIDE);
+    appendMoves(list, (piece << STRIDE) & empty, STRIDE);
+    appendMoves(list, (piece >> 1) & empty, -1);
+    appendMoves(list, (piece << 1) & empty, 1);
+    PROFILE_END(PROFILE_PIECE_MOVES);
 }
 
-
-// Function that returns an array of strings representing the possible positions a player can move.
-// The array of string is NULL terminated.
-char** getPlayerValidMoves(char** board, char player_sym)
+// Function that renders the position strings of a set of cells, separated by spaces.
+void renderCells(RenderBuffer* out, uint64_t cells)
 {
-    int alloc = 1;
-    char** list = (char**)malloc(sizeof(char*));
-    // List of player positions.
-    char** pos = getPlayerPositions(board, player_sym);
-    // Iterating through the positions of our player.
-    for (char** p = pos; *p != NULL; p++)
+    char pos[3];
+    for (; cells; cells &= cells - 1)
     {
-        // The position string in <row indicator><col indicator> format.
-        char* s = *p;
-        // We check the neighbourhood of this position to find all possible moves.
-        // The player position in integer coordinates.
-        int i = tolower(s[0]) - 'a';
-        int j = tolower(s[1]) - '0';
-
-        // Since, the player can move only horizontally or vertically there is no need of nested loop here.
-        // We check vertically possible positions.
-        for (int r = (i - 1); r <= (i + 1); r++)
-        {
-            if (r < 0 || r >= SIDE)
-            {
-                // Invalid row.
-                continue;
-            }
-            if (board[r][j] == 0)
-            {
-                // Vacant place for the piece.
-                // The position we found is vacant and hence its a valid move for the player.
-                list[alloc - 1] = (char*)malloc(sizeof(char) * 3);
-                // Row indicator character.
-                list[alloc - 1][0] = 'a' + r;
-                // Colum indicating numerical character.
-                list[alloc - 1][1] = '0' + j;
-                // The null terminator for this string.
-                list[alloc - 1][2] = 0;
-
-                // Next we grow list, so it can accomadate a future char*.
-                list = (char**)realloc(list, sizeof(char*) * (alloc + 1));
-                alloc++;
-            }
-        }
-
-        // Next we check horizontally possible directions.
-        for (int c = (j - 1); c <= (j + 1); c++)
-        {
-            if (c < 0 || c >= SIDE)
-            {
-                // Invalid row.
-                continue;
-            }
-            if (board[i][c] == 0)
-            {
-                // Vacant place for the piece.
-                // The position we found is vacant and hence its a valid move for the player.
-                list[alloc - 1] = (char*)malloc(sizeof(char) * 3);
-                // Row indicator character.
-                list[alloc - 1][0] = 'a' + i;
-                // Colum indicating numerical character.
-                list[alloc - 1][1] = '0' + c;
-                // The null terminator for this string.
-                list[alloc - 1][2] = 0;
-
-                // Next we grow list, so it can accomadate a future char*.
-                list = (char**)realloc(list, sizeof(char*) * (alloc + 1));
-                alloc++;
-            }
-        }
-
+        cellToString(lowestBit(cells), pos);
+        renderf(out, "%s ", pos);
     }
-    // The last string pointer is set to NULL, so that the end can be marked.
-    list[alloc - 1] = NULL;
-    return list;
 }
 
 
 // Function that returns the number of valid moves
-int countPlayerValidMoves(char** board, char player_sym)
+// Each direction is one shift and one popcount over the whole board.
+int countPlayerValidMoves(const BitBoard* board, char player_sym)
 {
-    char** list = getPlayerValidMoves(board, player_sym);
-    int ret = countPosStrings(list);
-    freeArray(list);
-    return ret;
+    uint64_t pieces = board->pieces[playerIndex(player_sym)];
+    uint64_t empty = emptyCells(board);
+    return popCount((pieces >> STRIDE) & empty) + popCount((pieces << STRIDE) & empty)
+        + popCount((pieces >> 1) & empty) + popCount((pieces << 1) & empty);
 }
 
 /*
  * Implementation of the function to check if the player chose a valid move.
  * It needs to know the piece position.
 */
-int isPlayerMoveValid(char** board, char player_sym, char* piece_pos, char* player_move)
+int isPlayerMoveValid(const BitBoard* board, char player_sym, char* piece_pos, char* player_move)
 {
     // The present position as integers.
     int i = tolower(piece_pos[0]) - 'a';
@@ -343,8 +860,15 @@ int isPlayerMoveValid(char** board, char player_sym, char* piece_pos, char* play
         return 0;
     }
 
+    // A piece slides one cell at a time, so the move must be a neighbour of the piece.
+    if (abs(row - i) + abs(col - j) != 1)
+    {
+        printf("ERROR: A piece only moves to a neighbouring cell. \n");
+        return 0;
+    }
+
     // Next we check to see if the chosen position is vacant.
-    if (board[row][col] != 0)
+    if (!(emptyCells(board) & (UINT64_C(1) << CELL(row, col))))
     {
         printf("ERROR: Chosen move position is already occupied! \n");
         return 0;
@@ -354,186 +878,5600 @@ int isPlayerMoveValid(char** board, char player_sym, char* piece_pos, char* play
     return 1;
 }
 
-// Function that returns a list of valid moves for a player piece at provided position string
-char** getPlayerPieceValidMoves(char** board, char* piece_pos)
+/*
+ * Symmetries.
+ * The square board looks the same after any of its 8 rotations and reflections, and a
+ * one-step orthogonal slide is still one after all of them, so the images of a position all
+ * have the same value. Symmetry s transposes the board when bit 2 is set, then flips the rows
+ * when bit 0 is set and mirrors the columns when bit 1 is set.
+*/
+#define SYMMETRIES 8
+
+// Where each symmetry takes each cell, and the symmetry that undoes each one.
+uint8_t symmetry_cells[SYMMETRIES][64];
+int inverse_symmetry[SYMMETRIES];
+
+// Function that turns the board upside down.
+uint64_t flipRows(uint64_t b)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    b = __builtin_bswap64(b);
+#else
+    b = ((b >> 8) & UINT64_C(0x00FF00FF00FF00FF)) | ((b & UINT64_C(0x00FF00FF00FF00FF)) << 8);
+    b = ((b >> 16) & UINT64_C(0x0000FFFF0000FFFF)) | ((b & UINT64_C(0x0000FFFF0000FFFF)) << 16);
+    b = (b >> 32) | (b << 32);
+#endif
+    // The unused rows at the top of the word ended up at the bottom.
+    return b >> ((STRIDE - SIDE) * STRIDE);
+}
+
+// Function that mirrors the board left to right.
+uint64_t mirrorColumns(uint64_t b)
+{
+    b = ((b >> 1) & UINT64_C(0x5555555555555555)) | ((b & UINT64_C(0x5555555555555555)) << 1);
+    b = ((b >> 2) & UINT64_C(0x3333333333333333)) | ((b & UINT64_C(0x3333333333333333)) << 2);
+    b = ((b >> 4) & UINT64_C(0x0F0F0F0F0F0F0F0F)) | ((b & UINT64_C(0x0F0F0F0F0F0F0F0F)) << 4);
+    // The guard column is now the first one of each row, and is empty.
+    return b >> (STRIDE - SIDE);
+}
+
+// Function that swaps rows and columns. The guard column and the unused rows swap with each other.
+uint64_t transposeCells(uint64_t b)
+{
+    uint64_t t = UINT64_C(0x0F0F0F0F00000000) & (b ^ (b << 28));
+    b ^= t ^ (t >> 28);
+    t = UINT64_C(0x3333000033330000) & (b ^ (b << 14));
+    b ^= t ^ (t >> 14);
+    t = UINT64_C(0x5500550055005500) & (b ^ (b << 7));
+    b ^= t ^ (t >> 7);
+    return b;
+}
+
+// Function that applies symmetry 's' to a set of cells.
+uint64_t transformCells(uint64_t b, int s)
 {
-    // If there is no piece at the provided position we return NULL.
-    if (!piece_pos)
+    if (s & 4)
     {
-        return NULL;
+        b = transposeCells(b);
+    }
+    if (s & 1)
+    {
+        b = flipRows(b);
     }
-    // The position in integer form.
-    int row = tolower(piece_pos[0]) - 'a';
-    int col = tolower(piece_pos[1]) - '0';
+    if (s & 2)
+    {
+        b = mirrorColumns(b);
+    }
+    return b;
+}
 
-    int alloc = 1;
-    char** list = (char**)malloc(sizeof(char*));
+// Function that carries a move through symmetry 's'.
+Move transformMove(Move move, int s)
+{
+    Move image = { symmetry_cells[s][move.from], symmetry_cells[s][move.to] };
+    return image;
+}
 
-    // Testing which all vertical moves are valid.
-    for (int r = (row - 1); r <= (row + 1); r++)
+void initSymmetries(void)
+{
+    for (int s = 0; s < SYMMETRIES; s++)
     {
-        if (r < 0 || r >= SIDE)
+        for (int cell = 0; cell < 64; cell++)
         {
-            // Invalid row.
-            continue;
+            uint64_t bit = UINT64_C(1) << cell;
+            symmetry_cells[s][cell] = (bit & BOARD_MASK) ? (uint8_t)lowestBit(transformCells(bit, s)) : (uint8_t)cell;
         }
-        if (board[r][col] == 0)
+    }
+    for (int s = 0; s < SYMMETRIES; s++)
+    {
+        for (int t = 0; t < SYMMETRIES; t++)
         {
-            // The position is vacant.
-            list[alloc - 1] = (char*)malloc(sizeof(char) * 3);
-            // Row indicator character.
-            list[alloc - 1][0] = 'a' + r;
-            // Colum indicating numerical character.
-            list[alloc - 1][1] = '0' + col;
-            // The null terminator for this string.
-            list[alloc - 1][2] = 0;
-            // Next we grow list, so it can accomadate a future char*.
-            list = (char**)realloc(list, sizeof(char*) * (alloc + 1));
-            alloc++;
+            if (symmetry_cells[t][symmetry_cells[s][CELL(0, 1)]] == CELL(0, 1)
+                && symmetry_cells[t][symmetry_cells[s][CELL(1, 0)]] == CELL(1, 0))
+            {
+                inverse_symmetry[s] = t;
+            }
         }
     }
+}
 
-    // Testing which all horizontal moves are valid.
-    for (int c = (col - 1); c <= (col + 1); c++)
+/*
+ * Zobrist hashing.
+ * Every (player, cell) pair and the side to move get a random 64-bit key; the hash of a
+ * position is the XOR of the keys that are present. A move flips two cell keys and the
+ * side key, so the hash is updated in O(1) as the game is played.
+ * The hash of every symmetric image is kept the same way, and the smallest of them is the key
+ * that all images share.
+*/
+uint64_t zobrist_cells[2][64];
+uint64_t zobrist_side;
+// zobrist_images[p][cell][s] is the key of the cell that symmetry s takes 'cell' to. The keys of
+// one cell are next to each other, so a move updates all the hashes with a few wide loads.
+uint64_t zobrist_images[2][64][SYMMETRIES];
+
+// Function that fills the Zobrist keys. A fixed seed keeps hashes identical between runs.
+void initZobrist(void)
+{
+    initSymmetries();
+    uint64_t state = UINT64_C(0x5851F42D4C957F2D);
+    for (int p = 0; p < 2; p++)
     {
-        if (c < 0 || c >= SIDE)
+        for (int cell = 0; cell < 64; cell++)
         {
-            // Invalid row.
-            continue;
+            zobrist_cells[p][cell] = splitMix64(&state);
+        }
+    }
+    zobrist_side = splitMix64(&state);
+    for (int s = 0; s < SYMMETRIES; s++)
+    {
+        for (int p = 0; p < 2; p++)
+        {
+            for (int cell = 0; cell < 64; cell++)
+            {
+                zobrist_images[p][cell][s] = zobrist_cells[p][symmetry_cells[s][cell]];
+            }
         }
-        if (board[row][c] == 0)
+    }
+}
+
+// Function that computes the Zobrist hash of a board from scratch.
+// 'side' is the player to move; the side key is present when 'O' is to move.
+uint64_t hashBoard(const BitBoard* board, int side)
+{
+    uint64_t hash = (side == O_INDEX) ? zobrist_side : 0;
+    for (int p = 0; p < 2; p++)
+    {
+        for (uint64_t b = board->pieces[p]; b; b &= b - 1)
         {
-            // The position is vacant.
-            list[alloc - 1] = (char*)malloc(sizeof(char) * 3);
-            // Row indicator character.
-            list[alloc - 1][0] = 'a' + row;
-            // Colum indicating numerical character.
-            list[alloc - 1][1] = '0' + c;
-            // The null terminator for this string.
-            list[alloc - 1][2] = 0;
-            // Next we grow list, so it can accomadate a future char*.
-            list = (char**)realloc(list, sizeof(char*) * (alloc + 1));
-            alloc++;
+            hash ^= zobrist_cells[p][lowestBit(b)];
         }
     }
+    return hash;
+}
+
+/*
+ * Game state.
+ * The board together with everything derived from it that the game loop and the search
+ * keep asking for: the side to move, the hash, each player's piece list and each player's
+ * number of valid moves. A move only changes the neighbourhoods of its two cells, so
+ * applyMove() updates all of it in O(1) instead of recounting the board.
+*/
+typedef struct GameState
+{
+    BitBoard board;
+    // Index of the player to move.
+    int side;
+    // Zobrist hash of the board and the side to move as seen through each symmetry;
+    // hashes[0] is the board as it stands.
+    uint64_t hashes[SYMMETRIES];
+    // Valid moves of each player, counted as (piece, vacant neighbour) pairs.
+    int mobility[2];
+    // The cells of each player's pieces, and the slot of each occupied cell in its owner's list.
+    int piece_count[2];
+    uint8_t piece_cells[2][MAX_PIECES];
+    uint8_t piece_slot[64];
+} GameState;
 
-    // Placing NULL as marker for the end of the array.
-    list[alloc - 1] = NULL;
-    return list;
+// Function that returns the cells one orthogonal step away from 'cell'.
+uint64_t neighbourCells(int cell)
+{
+    return stepTargets(UINT64_C(1) << cell, BOARD_MASK);
 }
 
-// Function to check if game is over.
-int isGameOver(char** board, int turn_user, int computer_first)
+// Function that builds the game state of a board with 'side' to move.
+void initGameState(GameState* state, const BitBoard* board, int side)
 {
-    // The array of player symbols.
-    char player_symbol[2] = { PLAYER_ONE, PLAYER_TWO };
-    // The symbol of the player that is going to play the next turn.
-    char player_sym = 0;
-    if (turn_user)
+    state->board = *board;
+    state->side = side;
+    for (int s = 0; s < SYMMETRIES; s++)
     {
-        // The user is the one who is going to play next turn.
-        player_sym = player_symbol[computer_first];
+        BitBoard image = { { transformCells(board->pieces[X_INDEX], s), transformCells(board->pieces[O_INDEX], s) } };
+        state->hashes[s] = hashBoard(&image, side);
     }
-    else {
-        player_sym = player_symbol[!computer_first];
+    for (int p = 0; p < 2; p++)
+    {
+        state->mobility[p] = countPlayerValidMoves(board, p == X_INDEX ? PLAYER_ONE : PLAYER_TWO);
+        state->piece_count[p] = 0;
+        for (uint64_t b = board->pieces[p]; b; b &= b - 1)
+        {
+            int cell = lowestBit(b);
+            state->piece_slot[cell] = (uint8_t)state->piece_count[p];
+            state->piece_cells[p][state->piece_count[p]++] = (uint8_t)cell;
+        }
+    }
+}
+
+// Function that plays a valid move of the player to move and passes the turn.
+void applyMove(GameState* state, Move move)
+{
+    int side = state->side;
+    uint64_t* pieces = state->board.pieces;
+    uint64_t from_near = neighbourCells(move.from);
+    uint64_t to_near = neighbourCells(move.to);
+
+    // Lifting the piece takes away its own moves, and every piece next to the vacated cell gains one.
+    state->mobility[side] -= popCount(from_near & emptyCells(&state->board));
+    pieces[side] ^= UINT64_C(1) << move.from;
+    state->mobility[X_INDEX] += popCount(from_near & pieces[X_INDEX]);
+    state->mobility[O_INDEX] += popCount(from_near & pieces[O_INDEX]);
+
+    // Putting it down costs every piece next to the destination one move, and adds the moves of the piece itself.
+    state->mobility[X_INDEX] -= popCount(to_near & pieces[X_INDEX]);
+    state->mobility[O_INDEX] -= popCount(to_near & pieces[O_INDEX]);
+    pieces[side] |= UINT64_C(1) << move.to;
+    state->mobility[side] += popCount(to_near & emptyCells(&state->board));
+
+    // The piece keeps its slot in the list.
+    uint8_t slot = state->piece_slot[move.from];
+    state->piece_cells[side][slot] = move.to;
+    state->piece_slot[move.to] = slot;
+
+    const uint64_t* from_keys = zobrist_images[side][move.from];
+    const uint64_t* to_keys = zobrist_images[side][move.to];
+    for (int s = 0; s < SYMMETRIES; s++)
+    {
+        state->hashes[s] ^= from_keys[s] ^ to_keys[s] ^ zobrist_side;
     }
+    state->side = !side;
+}
+
+/*
+ * Make and unmake.
+ * makeMove() plays a move in place and fills an undo record; unmakeMove() takes the record and
+ * puts the state back exactly as it was. A search walks the whole tree on one state this way,
+ * and the game keeps its records on a history stack for takeback and redo.
+*/
+typedef struct UndoRecord
+{
+    Move move;
+    // The hashes and mobilities before the move; the rest is put back by sliding the piece back.
+    uint64_t hashes[SYMMETRIES];
+    int mobility[2];
+} UndoRecord;
+
+void makeMove(GameState* state, Move move, UndoRecord* undo)
+{
+    undo->move = move;
+    undo->mobility[X_INDEX] = state->mobility[X_INDEX];
+    undo->mobility[O_INDEX] = state->mobility[O_INDEX];
+    memcpy(undo->hashes, state->hashes, sizeof(undo->hashes));
+    applyMove(state, move);
+}
+
+void unmakeMove(GameState* state, const UndoRecord* undo)
+{
+    int side = !state->side;
+    Move move = undo->move;
+    state->board.pieces[side] ^= (UINT64_C(1) << move.from) | (UINT64_C(1) << move.to);
+    uint8_t slot = state->piece_slot[move.to];
+    state->piece_cells[side][slot] = move.from;
+    state->piece_slot[move.from] = slot;
+    memcpy(state->hashes, undo->hashes, sizeof(state->hashes));
+    state->mobility[X_INDEX] = undo->mobility[X_INDEX];
+    state->mobility[O_INDEX] = undo->mobility[O_INDEX];
+    state->side = side;
+}
 
-    // We find all the valid possible moves for the player.
-    char** all_valid_moves = getPlayerValidMoves(board, player_sym);
-    if (countPosStrings(all_valid_moves) == 0)
+// The moves of a game, as undo records. records[0..count) have been played; records[count..length)
+// were taken back and can be redone until a different move is played.
+typedef struct GameHistory
+{
+    UndoRecord* records;
+    int count;
+    int length;
+    int capacity;
+} GameHistory;
+
+void initHistory(GameHistory* history)
+{
+    history->records = NULL;
+    history->count = 0;
+    history->length = 0;
+    history->capacity = 0;
+}
+
+void freeHistory(GameHistory* history)
+{
+    free(history->records);
+    initHistory(history);
+}
+
+// Function that plays a move of the game and pushes it on the history. Returns 0 if out of memory.
+int playMove(GameState* state, GameHistory* history, Move move)
+{
+    if (history->count == history->capacity)
     {
-        // There are no valid moves.
-        // Game over.
-        freeArray(all_valid_moves);
-        return 1;
+        int capacity = history->capacity ? history->capacity * 2 : 64;
+        PROFILE_ALLOCATION();
+        UndoRecord* records = (UndoRecord*)realloc(history->records, capacity * sizeof(UndoRecord));
+        if (records == NULL)
+        {
+            return 0;
+        }
+        history->records = records;
+        history->capacity = capacity;
+    }
+    makeMove(state, move, &history->records[history->count++]);
+    // A new move ends what could be redone.
+    history->length = history->count;
+    return 1;
+}
+
+// Function that takes back the last move played. Returns 0 if there is none.
+int takeBack(GameState* state, GameHistory* history)
+{
+    if (history->count == 0)
+    {
+        return 0;
+    }
+    unmakeMove(state, &history->records[--history->count]);
+    return 1;
+}
+
+// Function that plays again the last move taken back. Returns 0 if there is none.
+int redoMove(GameState* state, GameHistory* history)
+{
+    if (history->count == history->length)
+    {
+        return 0;
+    }
+    UndoRecord* record = &history->records[history->count++];
+    makeMove(state, record->move, record);
+    return 1;
+}
+
+// Function that returns the key shared by the position and all its symmetric images, and in
+// 'symmetry' the symmetry that takes the position to the image the key was taken from.
+uint64_t canonicalHash(const GameState* state, int* symmetry)
+{
+    int best = 0;
+    for (int s = 1; s < SYMMETRIES; s++)
+    {
+        if (state->hashes[s] < state->hashes[best])
+        {
+            best = s;
+        }
     }
+    *symmetry = best;
+    return state->hashes[best];
+}
+
+// Function to check if game is over: the player to move has no valid move left.
+int isGameOver(const GameState* state)
+{
+    PROFILE_BEGIN(PROFILE_GAME_OVER);
+    int over = state->mobility[state->side] == 0;
+    PROFILE_END(PROFILE_GAME_OVER);
+    return over;
+}
 
-    freeArray(all_valid_moves);
-    // Game is not over, and the player can make a turn.
-    return 0;
+// Outcome of a game: the winning player index, or -1 for a draw.
+#define DRAW (-1)
+
+// Function that decides the winner once the game stops: the player left without a move loses,
+// and at the turn limit the player with more valid moves wins.
+int decideWinner(const GameState* state, int game_over)
+{
+    if (game_over)
+    {
+        return !state->side;
+    }
+    if (state->mobility[X_INDEX] == state->mobility[O_INDEX])
+    {
+        return DRAW;
+    }
+    return (state->mobility[X_INDEX] > state->mobility[O_INDEX]) ? X_INDEX : O_INDEX;
 }
 
 
-// Function that calculates and displays the heuristic score for the game board.
-void calculateHeuristicScore(char** board)
+// Function that returns the heuristic score for the game state: the valid moves of 'X' minus those of 'O'.
+int heuristicScore(const GameState* state)
+{
+    PROFILE_BEGIN(PROFILE_HEURISTIC);
+    int score = state->mobility[X_INDEX] - state->mobility[O_INDEX];
+    PROFILE_END(PROFILE_HEURISTIC);
+    return score;
+}
+
+// Function that renders a heuristic score and what it says about the game.
+void renderHeuristicScore(RenderBuffer* out, int score)
 {
-    // Counting the valid moves possible for 'X'
-    int count_x = countPlayerValidMoves(board, PLAYER_ONE);
-    int count_o = countPlayerValidMoves(board, PLAYER_TWO);
-    int score = count_x - count_o;
-    printf("Heuristic score for the board state: %d\n", score);
+    renderf(out, "Heuristic score for the board state: %d\n", score);
 
     if (score < 0)
     {
         // The score is negative, implies the board state is favourable for player 'O'
-        printf("NOTE: Score indicates board state is more favourable for player 'O' \n");
+        renderf(out, "NOTE: Score indicates board state is more favourable for player 'O' \n");
+    }
+    else if (score > 0)
+    {
+        // A positive score implies the board state is more favourable for player 'X'
+        renderf(out, "NOTE: Score indicates board state is more favourable for player 'X' \n");
+    }
+    else {
+        // Zero score implies that the board state is favourable for both players.
+        renderf(out, "NOTE: Score indicates board state is favourable for both players! \n");
+    }
+}
+
+// Function that calculates and renders the heuristic score for the game state.
+void calculateHeuristicScore(RenderBuffer* out, const GameState* state)
+{
+    renderHeuristicScore(out, heuristicScore(state));
+}
+
+/*
+ * Batch evaluation.
+ * Many independent boards are scored at once from structure-of-arrays input: the 'X' pieces of every
+ * board in one array and the 'O' pieces in another. Each side's mobility takes the four shifts and
+ * masks of countPlayerValidMoves(), applied to eight boards per AVX-512 register, four per AVX2 register
+ * or two per SSE register. AVX-512 counts the bits with its own instruction; AVX2 and SSE look them up
+ * a nibble at a time. Other processors use the scalar loop.
+*/
+
+// A batch of boards and the results written for them; every array holds 'count' entries.
+typedef struct BoardBatch
+{
+    int count;
+    const uint64_t* x_pieces;
+    const uint64_t* o_pieces;
+    int32_t* x_moves;
+    int32_t* o_moves;
+    // The valid moves of 'X' minus those of 'O', as heuristicScore() gives them.
+    int32_t* scores;
+} BoardBatch;
+
+// The kernels of the batch evaluation, narrowest first.
+enum { BATCH_SCALAR, BATCH_SSSE3, BATCH_AVX2, BATCH_AVX512 };
+const char* const batch_kernel_names[] = { "scalar", "ssse3", "avx2", "avx512" };
+
+// Function that evaluates the boards of the batch from 'first' on, one at a time.
+void evaluateBatchScalar(const BoardBatch* batch, int first)
+{
+    for (int i = first; i < batch->count; i++)
+    {
+        uint64_t x = batch->x_pieces[i];
+        uint64_t o = batch->o_pieces[i];
+        uint64_t empty = BOARD_MASK & ~(x | o);
+        int x_moves = popCount((x >> STRIDE) & empty) + popCount((x << STRIDE) & empty)
+            + popCount((x >> 1) & empty) + popCount((x << 1) & empty);
+        int o_moves = popCount((o >> STRIDE) & empty) + popCount((o << STRIDE) & empty)
+            + popCount((o >> 1) & empty) + popCount((o << 1) & empty);
+        batch->x_moves[i] = x_moves;
+        batch->o_moves[i] = o_moves;
+        batch->scores[i] = x_moves - o_moves;
+    }
+}
+
+#ifdef BATCH_X86
+// Function that returns the valid moves of the pieces in each 64-bit lane. The byte counts of the
+// four directions are summed before the lanes are (at most 8 per direction, so a byte never overflows).
+__attribute__((target("avx2"))) static inline __m256i mobilityAvx2(__m256i pieces, __m256i empty)
+{
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i steps[4] = {
+        _mm256_and_si256(_mm256_srli_epi64(pieces, STRIDE), empty),
+        _mm256_and_si256(_mm256_slli_epi64(pieces, STRIDE), empty),
+        _mm256_and_si256(_mm256_srli_epi64(pieces, 1), empty),
+        _mm256_and_si256(_mm256_slli_epi64(pieces, 1), empty),
+    };
+    __m256i bytes = _mm256_setzero_si256();
+    for (int d = 0; d < 4; d++)
+    {
+        bytes = _mm256_add_epi8(bytes, _mm256_shuffle_epi8(table, _mm256_and_si256(steps[d], low)));
+        bytes = _mm256_add_epi8(bytes, _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(steps[d], 4), low)));
+    }
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+// Function that evaluates the batch four boards at a time.
+__attribute__((target("avx2"))) void evaluateBatchAvx2(const BoardBatch* batch)
+{
+    const __m256i mask = _mm256_set1_epi64x((long long)BOARD_MASK);
+    // Gathers the low halves of the four 64-bit lanes into the low 128 bits.
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    int i = 0;
+    for (; i + 4 <= batch->count; i += 4)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(batch->x_pieces + i));
+        __m256i o = _mm256_loadu_si256((const __m256i*)(batch->o_pieces + i));
+        __m256i empty = _mm256_andnot_si256(_mm256_or_si256(x, o), mask);
+        __m256i x_moves = mobilityAvx2(x, empty);
+        __m256i o_moves = mobilityAvx2(o, empty);
+        __m256i scores = _mm256_sub_epi64(x_moves, o_moves);
+        _mm_storeu_si128((__m128i*)(batch->x_moves + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(x_moves, pack)));
+        _mm_storeu_si128((__m128i*)(batch->o_moves + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(o_moves, pack)));
+        _mm_storeu_si128((__m128i*)(batch->scores + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(scores, pack)));
+    }
+    evaluateBatchScalar(batch, i);
+}
+
+// Function that evaluates the batch eight boards at a time, with the 64-bit population count of AVX-512.
+__attribute__((target("avx512f,avx512vpopcntdq"))) void evaluateBatchAvx512(const BoardBatch* batch)
+{
+    const __m512i mask = _mm512_set1_epi64((long long)BOARD_MASK);
+    int i = 0;
+    for (; i + 8 <= batch->count; i += 8)
+    {
+        __m512i x = _mm512_loadu_si512((const void*)(batch->x_pieces + i));
+        __m512i o = _mm512_loadu_si512((const void*)(batch->o_pieces + i));
+        __m512i empty = _mm512_andnot_si512(_mm512_or_si512(x, o), mask);
+        __m512i x_moves = _mm512_add_epi64(
+            _mm512_add_epi64(_mm512_popcnt_epi64(_mm512_and_si512(_mm512_srli_epi64(x, STRIDE), empty)),
+                _mm512_popcnt_epi64(_mm512_and_si512(_mm512_slli_epi64(x, STRIDE), empty))),
+            _mm512_add_epi64(_mm512_popcnt_epi64(_mm512_and_si512(_mm512_srli_epi64(x, 1), empty)),
+                _mm512_popcnt_epi64(_mm512_and_si512(_mm512_slli_epi64(x, 1), empty))));
+        __m512i o_moves = _mm512_add_epi64(
+            _mm512_add_epi64(_mm512_popcnt_epi64(_mm512_and_si512(_mm512_srli_epi64(o, STRIDE), empty)),
+                _mm512_popcnt_epi64(_mm512_and_si512(_mm512_slli_epi64(o, STRIDE), empty))),
+            _mm512_add_epi64(_mm512_popcnt_epi64(_mm512_and_si512(_mm512_srli_epi64(o, 1), empty)),
+                _mm512_popcnt_epi64(_mm512_and_si512(_mm512_slli_epi64(o, 1), empty))));
+        _mm256_storeu_si256((__m256i*)(batch->x_moves + i), _mm512_cvtepi64_epi32(x_moves));
+        _mm256_storeu_si256((__m256i*)(batch->o_moves + i), _mm512_cvtepi64_epi32(o_moves));
+        _mm256_storeu_si256((__m256i*)(batch->scores + i), _mm512_cvtepi64_epi32(_mm512_sub_epi64(x_moves, o_moves)));
+    }
+    evaluateBatchScalar(batch, i);
+}
+
+// Function that returns the valid moves of the pieces in each 64-bit lane, as mobilityAvx2() does.
+__attribute__((target("ssse3"))) static inline __m128i mobilitySsse3(__m128i pieces, __m128i empty)
+{
+    const __m128i table = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low = _mm_set1_epi8(0x0f);
+    __m128i steps[4] = {
+        _mm_and_si128(_mm_srli_epi64(pieces, STRIDE), empty),
+        _mm_and_si128(_mm_slli_epi64(pieces, STRIDE), empty),
+        _mm_and_si128(_mm_srli_epi64(pieces, 1), empty),
+        _mm_and_si128(_mm_slli_epi64(pieces, 1), empty),
+    };
+    __m128i bytes = _mm_setzero_si128();
+    for (int d = 0; d < 4; d++)
+    {
+        bytes = _mm_add_epi8(bytes, _mm_shuffle_epi8(table, _mm_and_si128(steps[d], low)));
+        bytes = _mm_add_epi8(bytes, _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(steps[d], 4), low)));
+    }
+    return _mm_sad_epu8(bytes, _mm_setzero_si128());
+}
+
+// Function that evaluates the batch two boards at a time.
+__attribute__((target("ssse3"))) void evaluateBatchSsse3(const BoardBatch* batch)
+{
+    const __m128i mask = _mm_set1_epi64x((long long)BOARD_MASK);
+    int i = 0;
+    for (; i + 2 <= batch->count; i += 2)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(batch->x_pieces + i));
+        __m128i o = _mm_loadu_si128((const __m128i*)(batch->o_pieces + i));
+        __m128i empty = _mm_andnot_si128(_mm_or_si128(x, o), mask);
+        __m128i x_moves = mobilitySsse3(x, empty);
+        __m128i o_moves = mobilitySsse3(o, empty);
+        __m128i scores = _mm_sub_epi64(x_moves, o_moves);
+        // The low halves of the two 64-bit lanes are moved next to each other and stored together.
+        _mm_storel_epi64((__m128i*)(batch->x_moves + i), _mm_shuffle_epi32(x_moves, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storel_epi64((__m128i*)(batch->o_moves + i), _mm_shuffle_epi32(o_moves, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storel_epi64((__m128i*)(batch->scores + i), _mm_shuffle_epi32(scores, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    evaluateBatchScalar(batch, i);
+}
+#endif
+
+// Function that returns the widest kernel this processor runs.
+int batchKernel(void)
+{
+#ifdef BATCH_X86
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+    {
+        return BATCH_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return BATCH_AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        return BATCH_SSSE3;
+    }
+#endif
+    return BATCH_SCALAR;
+}
+
+// Function that evaluates the batch with the given kernel, which must be one batchKernel() allows.
+void evaluateBatchWith(const BoardBatch* batch, int kernel)
+{
+#ifdef BATCH_X86
+    if (kernel == BATCH_AVX512)
+    {
+        evaluateBatchAvx512(batch);
+        return;
+    }
+    if (kernel == BATCH_AVX2)
+    {
+        evaluateBatchAvx2(batch);
+        return;
+    }
+    if (kernel == BATCH_SSSE3)
+    {
+        evaluateBatchSsse3(batch);
+        return;
+    }
+#endif
+    evaluateBatchScalar(batch, 0);
+}
+
+// Function that evaluates every board of the batch with the widest kernel available.
+void evaluateBatch(const BoardBatch* batch)
+{
+    evaluateBatchWith(batch, batchKernel());
+}
+
+/*
+ * Position notation.
+ * A position is written on one line: the rows 'a' to 'g' separated by '/', each row listing its cells
+ * from column 0 with 'X' and 'O' for pieces and a digit for a run of empty cells, then a space and
+ * the side to move ('x' or 'o'). The usual setup of 6 pieces per player might read
+ *     3X3/7/5O1/2X1O1X/O5O/1X1X1O1/1O3X1 x
+*/
+
+// Room for the longest position text and its terminator.
+#define POSITION_TEXT_SIZE (SIDE * (SIDE + 1) + 3)
+
+// Function that writes the position of the game state into 'out' (POSITION_TEXT_SIZE bytes).
+void formatPosition(const GameState* state, char* out)
+{
+    char* p = out;
+    for (int i = 0; i < SIDE; i++)
+    {
+        int empty = 0;
+        for (int j = 0; j < SIDE; j++)
+        {
+            char symbol = cellSymbol(&state->board, CELL(i, j));
+            if (symbol == ' ')
+            {
+                empty++;
+                continue;
+            }
+            if (empty > 0)
+            {
+                *p++ = (char)('0' + empty);
+                empty = 0;
+            }
+            *p++ = symbol;
+        }
+        if (empty > 0)
+        {
+            *p++ = (char)('0' + empty);
+        }
+        if (i < SIDE - 1)
+        {
+            *p++ = '/';
+        }
+    }
+    *p++ = ' ';
+    *p++ = (state->side == X_INDEX) ? 'x' : 'o';
+    *p = 0;
+}
+
+// Function that reads a position in the notation above into 'state'.
+// Returns 0, with the reason written into 'error', if the text is not a valid position.
+int parsePosition(const char* text, GameState* state, char* error, size_t size)
+{
+    BitBoard board = { { 0, 0 } };
+    const char* p = text;
+    for (int i = 0; i < SIDE; i++)
+    {
+        int j = 0;
+        while (j < SIDE)
+        {
+            char c = (char)toupper((unsigned char)*p);
+            if (c >= '1' && c <= '0' + SIDE)
+            {
+                j += c - '0';
+            }
+            else if (c == PLAYER_ONE || c == PLAYER_TWO)
+            {
+                board.pieces[playerIndex(c)] |= UINT64_C(1) << CELL(i, j);
+                j++;
+            }
+            else if (c == 0)
+            {
+                snprintf(error, size, "row %c is cut short", 'a' + i);
+                return 0;
+            }
+            else {
+                snprintf(error, size, "unexpected '%c' in row %c", *p, 'a' + i);
+                return 0;
+            }
+            p++;
+        }
+        if (j > SIDE)
+        {
+            snprintf(error, size, "row %c has more than %d cells", 'a' + i, SIDE);
+            return 0;
+        }
+        if (i < SIDE - 1 && *p++ != '/')
+        {
+            snprintf(error, size, "row %c does not end with '/'", 'a' + i);
+            return 0;
+        }
+    }
+    char side = (char)toupper((unsigned char)p[1]);
+    if (p[0] != ' ' || (side != PLAYER_ONE && side != PLAYER_TWO))
+    {
+        snprintf(error, size, "the board must be followed by a space and the side to move, 'x' or 'o'");
+        return 0;
+    }
+    for (p += 2; *p; p++)
+    {
+        if (!isspace((unsigned char)*p))
+        {
+            snprintf(error, size, "unexpected text after the side to move");
+            return 0;
+        }
+    }
+    if (popCount(board.pieces[X_INDEX]) > MAX_PIECES || popCount(board.pieces[O_INDEX]) > MAX_PIECES)
+    {
+        snprintf(error, size, "a player has more than %d pieces", MAX_PIECES);
+        return 0;
+    }
+    initGameState(state, &board, playerIndex(side));
+    return 1;
+}
+
+// Function that waits for the given time.
+void sleepNanoseconds(uint64_t nanoseconds)
+{
+#ifdef _WIN32
+    Sleep((DWORD)(nanoseconds / 1000000u));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(nanoseconds / 1000000000u);
+    ts.tv_nsec = (long)(nanoseconds % 1000000000u);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Function that returns the number of processors online.
+int processorCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+/***************************************************
+ * Endgame tablebase.
+ *
+ * Pieces are never captured, so a game keeps the number of pieces it started
+ * with. For a few pieces per side every position can be solved outright, by
+ * retrograde analysis from the positions where the side to move is stuck.
+ * The results are written to a file that the engine maps into memory; only
+ * the pages that are probed are ever read from disk.
+****************************************************/
+
+// Most pieces per side a tablebase can hold. Four would take 31 GB.
+#define TB_MAX_PIECES 3
+// The file read at startup when no other is given.
+#define TB_DEFAULT_FILE "xo-tablebase.bin"
+// "XOTB" in the first four bytes of the file.
+#define TB_MAGIC 0x42544F58u
+#define TB_VERSION 2
+
+/*
+ * A position is stored from the side to move's point of view: "us" is the side to move and
+ * "them" the other side, so one entry serves both colours. Only one of the symmetric images of a
+ * position is stored: the one whose (us, them) pair of bit sets is the smallest. Its index is the
+ * number of the class of the cells of "us" (the sets of k cells that are the smallest of their
+ * images, in order), times the number of ways to place "them", plus the rank of the cells of
+ * "them" among the 49 - k cells left over, in the combinatorial number system. Entries whose
+ * position is not the chosen image are never used.
+ *
+ * An entry is one byte: 0 is a draw (neither side can force the other to get stuck), and
+ * v > 0 means the game ends v - 1 plies from now with best play. That distance is odd when the
+ * side to move wins and even when it loses.
+*/
+#define TB_DRAW 0
+// Longest distance an entry can hold.
+#define TB_MAX_DISTANCE 254
+
+typedef struct TablebaseHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    // Must match SIDE.
+    uint32_t side;
+    uint32_t max_pieces;
+    // Byte offset of the table for k pieces per side, for k = 1..max_pieces.
+    uint64_t offsets[TB_MAX_PIECES + 1];
+} TablebaseHeader;
+
+typedef struct Tablebase
+{
+    // Highest number of pieces per side covered, 0 when no tablebase is loaded.
+    int max_pieces;
+    const uint8_t* tables[TB_MAX_PIECES + 1];
+    // The mapping of the whole file.
+    void* map;
+    size_t map_size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} Tablebase;
+
+// The tablebase the engine probes. Read-only once loaded, so all search threads share it.
+Tablebase tablebase;
+
+// Binomial coefficients C(n, k) for n up to the number of cells.
+uint64_t tb_binomial[SIDE * SIDE + 1][TB_MAX_PIECES + 1];
+// The number of sets of k cells, C(49, k), for the largest k.
+#define TB_MAX_SETS 18424
+// For each set of k cells, by its rank: its class number, or -1 when it is not the smallest of its images.
+int32_t tb_class_of[TB_MAX_PIECES + 1][TB_MAX_SETS];
+// For each class, the rank of its set of cells, and the number of classes.
+uint32_t tb_class_rank[TB_MAX_PIECES + 1][TB_MAX_SETS];
+uint64_t tb_class_count[TB_MAX_PIECES + 1];
+
+// Function that packs a set of board cells into bits 0..48, one row of SIDE bits after another.
+uint64_t denseCells(uint64_t cells)
+{
+    uint64_t dense = 0;
+    for (int i = 0; i < SIDE; i++)
+    {
+        dense |= ((cells >> (i * STRIDE)) & ((UINT64_C(1) << SIDE) - 1)) << (i * SIDE);
+    }
+    return dense;
+}
+
+// Function that does the opposite of denseCells().
+uint64_t sparseCells(uint64_t dense)
+{
+    uint64_t cells = 0;
+    for (int i = 0; i < SIDE; i++)
+    {
+        cells |= ((dense >> (i * SIDE)) & ((UINT64_C(1) << SIDE) - 1)) << (i * STRIDE);
+    }
+    return cells;
+}
+
+// Function that returns the rank of a set of cells (as bits 0..n-1) among the sets of the same size.
+uint64_t rankCells(uint64_t dense)
+{
+    uint64_t rank = 0;
+    int i = 1;
+    for (uint64_t b = dense; b; b &= b - 1, i++)
+    {
+        rank += tb_binomial[lowestBit(b)][i];
+    }
+    return rank;
+}
+
+// Function that returns the 'rank'-th set of k cells out of n, as bits 0..n-1.
+uint64_t unrankCells(uint64_t rank, int n, int k)
+{
+    uint64_t set = 0;
+    for (int i = k; i > 0; i--)
+    {
+        int c = n - 1;
+        while (tb_binomial[c][i] > rank)
+        {
+            c--;
+        }
+        rank -= tb_binomial[c][i];
+        set |= UINT64_C(1) << c;
+        n = c;
+    }
+    return set;
+}
+
+// Function that fills the tables the indexing needs. It only runs once.
+void initTablebaseIndexing(void)
+{
+    static int ready = 0;
+    if (ready)
+    {
+        return;
+    }
+    for (int n = 0; n <= SIDE * SIDE; n++)
+    {
+        tb_binomial[n][0] = 1;
+        for (int k = 1; k <= TB_MAX_PIECES; k++)
+        {
+            tb_binomial[n][k] = (n == 0) ? 0 : tb_binomial[n - 1][k - 1] + tb_binomial[n - 1][k];
+        }
+    }
+    for (int k = 1; k <= TB_MAX_PIECES; k++)
+    {
+        tb_class_count[k] = 0;
+        for (uint64_t rank = 0; rank < tb_binomial[SIDE * SIDE][k]; rank++)
+        {
+            uint64_t cells = sparseCells(unrankCells(rank, SIDE * SIDE, k));
+            int smallest = 1;
+            for (int s = 1; s < SYMMETRIES && smallest; s++)
+            {
+                smallest = transformCells(cells, s) >= cells;
+            }
+            tb_class_of[k][rank] = smallest ? (int32_t)tb_class_count[k] : -1;
+            if (smallest)
+            {
+                tb_class_rank[k][tb_class_count[k]++] = (uint32_t)rank;
+            }
+        }
+    }
+    ready = 1;
+}
+
+// Function that returns the number of entries of the table for k pieces per side.
+uint64_t tablebaseSize(int k)
+{
+    return tb_class_count[k] * tb_binomial[SIDE * SIDE - k][k];
+}
+
+// Function that returns the index of a position among those with the same number of pieces per side.
+uint64_t tablebaseIndex(uint64_t us, uint64_t them, int k)
+{
+    // The image with the smallest (us, them) pair stands for all of them.
+    uint64_t best_us = us;
+    uint64_t best_them = them;
+    for (int s = 1; s < SYMMETRIES; s++)
+    {
+        uint64_t image_us = transformCells(us, s);
+        uint64_t image_them = transformCells(them, s);
+        if (image_us < best_us || (image_us == best_us && image_them < best_them))
+        {
+            best_us = image_us;
+            best_them = image_them;
+        }
+    }
+    uint64_t dense_us = denseCells(best_us);
+    uint64_t rank_them = 0;
+    int i = 1;
+    for (uint64_t b = denseCells(best_them); b; b &= b - 1, i++)
+    {
+        // The cells of "us" are left out, so the rank counts only the cells "them" could use.
+        int cell = lowestBit(b);
+        int free_below = cell - popCount(dense_us & ((UINT64_C(1) << cell) - 1));
+        rank_them += tb_binomial[free_below][i];
+    }
+    return (uint64_t)tb_class_of[k][rankCells(dense_us)] * tb_binomial[SIDE * SIDE - k][k] + rank_them;
+}
+
+// Function that returns the position stored at 'index'.
+void tablebasePosition(uint64_t index, int k, uint64_t* us, uint64_t* them)
+{
+    uint64_t per_us = tb_binomial[SIDE * SIDE - k][k];
+    uint64_t dense_us = unrankCells(tb_class_rank[k][index / per_us], SIDE * SIDE, k);
+    uint64_t slots = unrankCells(index % per_us, SIDE * SIDE - k, k);
+    // Slot s of "them" is the s-th cell not taken by "us".
+    uint64_t dense_them = 0;
+    int slot = 0;
+    for (int cell = 0; cell < SIDE * SIDE; cell++)
+    {
+        if (dense_us & (UINT64_C(1) << cell))
+        {
+            continue;
+        }
+        if (slots & (UINT64_C(1) << slot))
+        {
+            dense_them |= UINT64_C(1) << cell;
+        }
+        slot++;
+    }
+    *us = sparseCells(dense_us);
+    *them = sparseCells(dense_them);
+}
+
+// Function that checks whether every move of the side to move leads to a position won by the
+// opponent (an entry with an odd distance).
+int allMovesLose(uint64_t us, uint64_t them, int k, const uint8_t* values)
+{
+    uint64_t empty = BOARD_MASK & ~(us | them);
+    for (uint64_t b = us; b; b &= b - 1)
+    {
+        uint64_t piece = b & -b;
+        for (uint64_t to = stepTargets(piece, empty); to; to &= to - 1)
+        {
+            uint8_t value = values[tablebaseIndex(them, us ^ piece ^ (to & -to), k)];
+            if (value == TB_DRAW || ((value - 1) & 1) == 0)
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Function that solves every position with k pieces per side into 'values', and counts them.
+ * Positions where the side to move is stuck are lost at distance 0. Then, one distance at a time,
+ * every position decided at distance d is unmade: the side that just moved slides a piece back.
+ * A predecessor of a lost position is won at d + 1. A predecessor of a won position is lost at
+ * d + 1 once all its moves are known to lead to wins for the opponent; all wins up to distance d
+ * are known by then. Whatever is left undecided at the end is a draw.
+ * Returns 0 if a distance would not fit an entry.
+*/
+int solveTablebase(int k, uint8_t* values, uint64_t* positions)
+{
+    uint64_t size = tablebaseSize(k);
+    *positions = 0;
+    for (uint64_t index = 0; index < size; index++)
+    {
+        uint64_t us, them;
+        tablebasePosition(index, k, &us, &them);
+        values[index] = TB_DRAW;
+        if (tablebaseIndex(us, them, k) != index)
+        {
+            // Another entry holds this position.
+            continue;
+        }
+        (*positions)++;
+        if (stepTargets(us, BOARD_MASK & ~(us | them)) == 0)
+        {
+            values[index] = 1;
+        }
+    }
+
+    for (int distance = 0; ; distance++)
+    {
+        if (distance >= TB_MAX_DISTANCE)
+        {
+            printf("ERROR: A position with %d pieces per side lasts more than %d plies. \n", k, TB_MAX_DISTANCE);
+            return 0;
+        }
+        uint8_t value = (uint8_t)(distance + 1);
+        uint64_t found = 0;
+        for (uint64_t index = 0; index < size; index++)
+        {
+            if (values[index] != value)
+            {
+                continue;
+            }
+            found++;
+            uint64_t us, them;
+            tablebasePosition(index, k, &us, &them);
+            uint64_t empty = BOARD_MASK & ~(us | them);
+            // "them" moved last, from an empty neighbour onto one of its pieces.
+            for (uint64_t b = them; b; b &= b - 1)
+            {
+                uint64_t piece = b & -b;
+                for (uint64_t from = stepTargets(piece, empty); from; from &= from - 1)
+                {
+                    uint64_t before = them ^ piece ^ (from & -from);
+                    uint64_t previous = tablebaseIndex(before, us, k);
+                    if (values[previous] != TB_DRAW)
+                    {
+                        continue;
+                    }
+                    // A lost position (even distance) makes the move into it a win. A won one
+                    // settles the predecessor only when its other moves lose as well.
+                    if ((distance & 1) == 0 || allMovesLose(before, us, k, values))
+                    {
+                        values[previous] = (uint8_t)(value + 1);
+                    }
+                }
+            }
+        }
+        if (found == 0)
+        {
+            break;
+        }
+    }
+    return 1;
+}
+
+// Function that solves every position up to 'max_pieces' per side and writes the tablebase file.
+// Returns nonzero on success.
+int generateTablebase(const char* path, int max_pieces)
+{
+    initTablebaseIndexing();
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TB_MAGIC;
+    header.version = TB_VERSION;
+    header.side = SIDE;
+    header.max_pieces = (uint32_t)max_pieces;
+    uint64_t offset = sizeof(header);
+    for (int k = 1; k <= max_pieces; k++)
+    {
+        header.offsets[k] = offset;
+        offset += tablebaseSize(k);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("ERROR: Could not create the tablebase file '%s'. \n", path);
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int k = 1; ok && k <= max_pieces; k++)
+    {
+        uint64_t size = tablebaseSize(k);
+        uint64_t start = nowNanoseconds();
+        uint8_t* values = (uint8_t*)malloc(size);
+        uint64_t positions = 0;
+        ok = values != NULL && solveTablebase(k, values, &positions);
+        if (ok)
+        {
+            uint64_t wins = 0, losses = 0, longest = 0;
+            for (uint64_t i = 0; i < size; i++)
+            {
+                if (values[i] != TB_DRAW)
+                {
+                    uint64_t distance = values[i] - 1u;
+                    (distance & 1) ? wins++ : losses++;
+                    longest = (distance > longest) ? distance : longest;
+                }
+            }
+            printf("%d piece(s) per side: %llu positions in %llu entries, %llu won, %llu lost, %llu drawn, longest %llu plies, %.2f s\n",
+                k, (unsigned long long)positions, (unsigned long long)size, (unsigned long long)wins, (unsigned long long)losses,
+                (unsigned long long)(positions - wins - losses), (unsigned long long)longest, (nowNanoseconds() - start) / 1e9);
+            ok = fwrite(values, 1, size, file) == size;
+        }
+        else if (values == NULL)
+        {
+            printf("ERROR: Not enough memory to solve %d pieces per side. \n", k);
+        }
+        free(values);
+    }
+    if (fclose(file) != 0 || !ok)
+    {
+        printf("ERROR: Could not write the tablebase file '%s'. \n", path);
+        remove(path);
+        return 0;
+    }
+    return 1;
+}
+
+void closeTablebase(Tablebase* tb)
+{
+    if (tb->map != NULL)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(tb->map);
+        CloseHandle(tb->mapping);
+        CloseHandle(tb->file);
+#else
+        munmap(tb->map, tb->map_size);
+#endif
+    }
+    memset(tb, 0, sizeof(Tablebase));
+}
+
+// Function that maps a tablebase file into memory. Returns nonzero on success.
+int openTablebase(Tablebase* tb, const char* path)
+{
+    initTablebaseIndexing();
+    memset(tb, 0, sizeof(Tablebase));
+#ifdef _WIN32
+    tb->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (tb->file == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(tb->file, &size);
+    tb->map_size = (size_t)size.QuadPart;
+    tb->mapping = CreateFileMappingA(tb->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    tb->map = tb->mapping ? MapViewOfFile(tb->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (tb->map == NULL)
+    {
+        if (tb->mapping)
+        {
+            CloseHandle(tb->mapping);
+        }
+        CloseHandle(tb->file);
+        return 0;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return 0;
+    }
+    tb->map_size = (size_t)info.st_size;
+    tb->map = mmap(NULL, tb->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid without the descriptor.
+    close(fd);
+    if (tb->map == MAP_FAILED)
+    {
+        tb->map = NULL;
+        return 0;
+    }
+#if defined(POSIX_MADV_RANDOM)
+    // Probes jump all over the file; reading ahead would only pull in pages nobody asks for.
+    posix_madvise(tb->map, tb->map_size, POSIX_MADV_RANDOM);
+#endif
+#endif
+
+    const TablebaseHeader* header = (const TablebaseHeader*)tb->map;
+    int valid = tb->map_size >= sizeof(TablebaseHeader) && header->magic == TB_MAGIC && header->version == TB_VERSION
+        && header->side == SIDE && header->max_pieces >= 1 && header->max_pieces <= TB_MAX_PIECES;
+    for (int k = 1; valid && k <= (int)header->max_pieces; k++)
+    {
+        valid = header->offsets[k] + tablebaseSize(k) <= tb->map_size;
+        tb->tables[k] = (const uint8_t*)tb->map + header->offsets[k];
+    }
+    if (!valid)
+    {
+        printf("ERROR: '%s' is not a tablebase for this board. \n", path);
+        closeTablebase(tb);
+        return 0;
+    }
+    tb->max_pieces = (int)header->max_pieces;
+    return 1;
+}
+
+// Function that looks the game state up in the tablebase. Returns the entry (TB_DRAW or
+// distance + 1), or -1 when the position is not covered.
+int probeTablebase(const Tablebase* tb, const GameState* state)
+{
+    int k = state->piece_count[state->side];
+    if (k > tb->max_pieces || k != state->piece_count[!state->side])
+    {
+        return -1;
+    }
+    return tb->tables[k][tablebaseIndex(state->board.pieces[state->side], state->board.pieces[!state->side], k)];
+}
+
+/***************************************************
+ * Computer player.
+ *
+ * The computer picks its move either greedily (the original rule: a random
+ * move of the piece with the most moves), with a negamax alpha-beta search
+ * whose leaves are scored by heuristicScore(), or by Monte Carlo tree search.
+****************************************************/
+
+// Engines that can play the computer's side.
+#define ENGINE_GREEDY 0
+#define ENGINE_ALPHABETA 1
+#define ENGINE_MCTS 2
+
+// Default search depth, in plies.
+#define DEFAULT_DEPTH 6
+// Deepest search allowed; the depth limit under a time budget when no depth is given.
+#define MAX_DEPTH 100
+// Default transposition table size, in megabytes.
+#define DEFAULT_HASH_MB 16
+// Most search threads allowed.
+#define MAX_THREADS 256
+// Default playouts per move of the Monte Carlo engine, and the default cap on its tree nodes.
+#define DEFAULT_PLAYOUTS 20000
+#define DEFAULT_MCTS_NODES (1 << 20)
+
+// Score of a won game. The distance from the root is subtracted, so quicker wins score higher.
+// Mobility scores stay far below it, and it fits the 16-bit score of a table entry.
+#define WIN_SCORE 30000
+// Scores beyond this are wins or losses at a known distance.
+#define WIN_BOUND (WIN_SCORE - 1000)
+
+// Settings of the engine playing the computer's side.
+typedef struct EngineConfig
+{
+    // One of the ENGINE_* constants.
+    int kind;
+    // Search depth in plies for the alpha-beta engine; the limit of iterative deepening under a time budget.
+    int depth;
+    // Time budget per move in milliseconds, or 0 to always search to 'depth'.
+    int movetime_ms;
+    // Memory budget of the transposition table, in megabytes.
+    int hash_mb;
+    // Number of search threads sharing the transposition table.
+    int threads;
+    // Playouts per move of the Monte Carlo engine when there is no time budget, and the cap on its tree nodes.
+    int playouts;
+    int mcts_nodes;
+} EngineConfig;
+
+// Outcome of a search for the computer's move.
+typedef struct SearchResult
+{
+    Move best;
+    int score;
+    int depth;
+    // Nodes searched by all threads together.
+    uint64_t nodes;
+    uint64_t nanoseconds;
+    // Number of threads that took part.
+    int threads;
+    // Time from the start of the search until each depth was completed, or 0 if it was not.
+    uint64_t depth_nanoseconds[MAX_DEPTH + 1];
+    // Nonzero when the move was read from the tablebase instead of searched.
+    int tablebase;
+    // Nonzero when the endgame solver searched exactly to the turn limit; 'depth' is then the plies to it.
+    int solved;
+    // Monte Carlo engine: playouts run and tree nodes used. Its score is the expected result in thousandths.
+    uint64_t playouts;
+    int tree_nodes;
+} SearchResult;
+
+/*
+ * Transposition table.
+ * A power-of-two array of entries indexed by the low bits of the hash. An entry keeps the
+ * score of a searched position together with the depth it was searched to, whether the
+ * score is exact or only a bound, and the best move found, which is tried first next time.
+ *
+ * Search threads share the table without locks. An entry is two 64-bit words: the packed
+ * data, and the hash XORed with that data. When two threads write the same entry at once
+ * and the words get mixed, the check no longer matches and the entry reads as a miss.
+*/
+#define BOUND_EXACT 0
+#define BOUND_LOWER 1
+#define BOUND_UPPER 2
+
+typedef struct TTEntry
+{
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} TTEntry;
+
+// The unpacked data of an entry.
+typedef struct TTData
+{
+    int score;
+    int depth;
+    int bound;
+    // Search generation that wrote the entry; entries of older searches are replaced first.
+    int generation;
+    Move best;
+} TTData;
+
+typedef struct TranspositionTable
+{
+    TTEntry* entries;
+    // Number of entries minus one; the number of entries is a power of two.
+    uint64_t mask;
+    uint8_t generation;
+} TranspositionTable;
+
+// Function that packs entry data into one word: score 16 bits, depth 8, bound 2, generation 8, move 16.
+uint64_t ttPack(const TTData* d)
+{
+    return (uint64_t)(uint16_t)d->score | ((uint64_t)d->depth << 16) | ((uint64_t)d->bound << 24)
+        | ((uint64_t)(d->generation & 0xFF) << 26) | ((uint64_t)d->best.from << 34) | ((uint64_t)d->best.to << 42);
+}
+
+// Function that unpacks a word written by ttPack().
+void ttUnpack(uint64_t data, TTData* d)
+{
+    d->score = (int16_t)(data & 0xFFFF);
+    d->depth = (int)((data >> 16) & 0xFF);
+    d->bound = (int)((data >> 24) & 0x3);
+    d->generation = (int)((data >> 26) & 0xFF);
+    d->best.from = (uint8_t)((data >> 34) & 0xFF);
+    d->best.to = (uint8_t)((data >> 42) & 0xFF);
+}
+
+// Function that allocates a table of the largest power-of-two size that fits in 'megabytes'.
+// Returns 0 if the memory cannot be allocated.
+int ttInit(TranspositionTable* tt, int megabytes)
+{
+    uint64_t budget = (uint64_t)megabytes * 1024 * 1024;
+    uint64_t count = 1;
+    while (count * 2 * sizeof(TTEntry) <= budget)
+    {
+        count *= 2;
+    }
+    tt->entries = (TTEntry*)calloc(count, sizeof(TTEntry));
+    tt->mask = count - 1;
+    tt->generation = 0;
+    return tt->entries != NULL;
+}
+
+// Function that empties a table.
+void ttClear(TranspositionTable* tt)
+{
+    memset(tt->entries, 0, (tt->mask + 1) * sizeof(TTEntry));
+    tt->generation = 0;
+}
+
+// Function that releases the memory of a table.
+void ttFree(TranspositionTable* tt)
+{
+    free(tt->entries);
+    tt->entries = NULL;
+}
+
+// Win and loss scores are stored relative to the position rather than to the root,
+// so an entry stays correct when the position is reached at another distance.
+int scoreToTable(int score, int ply)
+{
+    if (score > WIN_BOUND)
+    {
+        return score + ply;
+    }
+    if (score < -WIN_BOUND)
+    {
+        return score - ply;
+    }
+    return score;
+}
+
+int scoreFromTable(int score, int ply)
+{
+    if (score > WIN_BOUND)
+    {
+        return score - ply;
+    }
+    if (score < -WIN_BOUND)
+    {
+        return score + ply;
+    }
+    return score;
+}
+
+// Function that reads the entry stored for 'hash' into 'out'. Returns 0 if there is none.
+int ttProbe(TranspositionTable* tt, uint64_t hash, TTData* out)
+{
+    TTEntry* entry = &tt->entries[hash & tt->mask];
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+    uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    if ((check ^ data) != hash)
+    {
+        return 0;
+    }
+    ttUnpack(data, out);
+    return 1;
+}
+
+// Function that stores a search result. An entry of the current search is only replaced
+// by a result searched at least as deep; entries left over from earlier searches always give way.
+void ttStore(TranspositionTable* tt, uint64_t hash, int depth, int bound, int score, int ply, Move best)
+{
+    TTEntry* entry = &tt->entries[hash & tt->mask];
+    uint64_t old_data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    uint64_t old_hash = atomic_load_explicit(&entry->check, memory_order_relaxed) ^ old_data;
+    TTData old;
+    ttUnpack(old_data, &old);
+    if (old_hash == hash || old.generation != tt->generation || depth >= old.depth)
+    {
+        TTData d = { scoreToTable(score, ply), depth, bound, tt->generation, best };
+        uint64_t data = ttPack(&d);
+        atomic_store_explicit(&entry->check, hash ^ data, memory_order_relaxed);
+        atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+    }
+}
+
+// State of one search thread.
+typedef struct SearchContext
+{
+    TranspositionTable* tt;
+    uint64_t nodes;
+    // Timestamp at which the search must stop, or 0 for no time limit.
+    uint64_t deadline;
+    // Raised by the main search thread when it is done; helper threads then stop too.
+    atomic_int* stop;
+    // Set once the search has to stop; every node then unwinds without storing anything.
+    int stopped;
+    // Thread number; 0 is the main search thread.
+    int id;
+    // Plies from the root to the turn limit, or 0 for no limit.
+    int plies_left;
+} SearchContext;
+
+// How many nodes are searched between two looks at the clock.
+#define CLOCK_CHECK_NODES 1024
+
+// Function that scores the state from the point of view of the player to move.
+int evaluate(const GameState* state)
+{
+    int score = heuristicScore(state);
+    return (state->side == X_INDEX) ? score : -score;
+}
+
+// Function that moves 'best' to the front of the list, if it is in the list.
+void orderFirst(MoveList* list, Move best)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        if (list->moves[i].from == best.from && list->moves[i].to == best.to)
+        {
+            list->moves[i] = list->moves[0];
+            list->moves[0] = best;
+            return;
+        }
+    }
+}
+
+/*
+ * Negamax search with alpha-beta pruning.
+ * Returns the score of the state for the player to move, searched 'depth' plies deep.
+ * A player who cannot slide any piece has lost.
+*/
+// Function that converts a won or lost tablebase entry to a score at 'ply', on the same scale as a
+// game searched to its end.
+int tablebaseScore(int entry, int ply)
+{
+    int distance = entry - 1;
+    return (distance & 1) ? WIN_SCORE - ply - distance : -WIN_SCORE + ply + distance;
+}
+
+// Function that tells whether a won or lost tablebase entry holds at 'ply', with the turn limit 'plies_left'
+// plies from the root (0 for no limit). The tablebase knows no limit: a player stuck on or after the last
+// turn is judged by mobility instead, so the entry only counts when the game is stuck before that.
+static inline int tablebaseEntryHolds(int entry, int plies_left, int ply)
+{
+    return plies_left == 0 || entry - 1 < plies_left - ply;
+}
+
+// Function that picks the move of a won or lost position straight from the tablebase: the quickest
+// win, or the slowest loss. Returns 0 when the position is not covered, is drawn, or is only decided
+// after the turn limit, 'plies_left' plies away (0 for no limit).
+int tablebaseMove(const GameState* state, int plies_left, SearchResult* result)
+{
+    int entry = (tablebase.max_pieces > 0) ? probeTablebase(&tablebase, state) : -1;
+    if (entry <= TB_DRAW || !tablebaseEntryHolds(entry, plies_left, 0))
+    {
+        return 0;
+    }
+    MoveList list;
+    generateMoves(&state->board, state->side, &list);
+    int best = -WIN_SCORE - 1;
+    for (int i = 0; i < list.count; i++)
+    {
+        GameState child = *state;
+        applyMove(&child, list.moves[i]);
+        int child_entry = probeTablebase(&tablebase, &child);
+        int score = (child_entry == TB_DRAW) ? 0 : -tablebaseScore(child_entry, 1);
+        if (score > best)
+        {
+            best = score;
+            result->best = list.moves[i];
+        }
+    }
+    result->score = best;
+    result->depth = 0;
+    result->nodes = 0;
+    result->threads = 0;
+    result->tablebase = 1;
+    return 1;
+}
+
+int negamax(SearchContext* ctx, GameState* state, int depth, int alpha, int beta, int ply)
+{
+    ctx->nodes++;
+    if ((ctx->nodes % CLOCK_CHECK_NODES) == 0
+        && ((ctx->deadline && nowNanoseconds() >= ctx->deadline) || atomic_load_explicit(ctx->stop, memory_order_relaxed)))
+    {
+        ctx->stopped = 1;
+    }
+    if (ctx->stopped)
+    {
+        return 0;
+    }
+    if (isGameOver(state))
+    {
+        // No legal slide: the player to move has lost.
+        return -WIN_SCORE + ply;
+    }
+    if (tablebase.max_pieces > 0 && depth > 0)
+    {
+        // A solved position needs no search. Drawn ones are still searched, as the turn limit
+        // decides them by mobility, and so are those the limit comes to first. Leaves are not probed:
+        // a cache miss into the file costs more than the evaluation it would replace.
+        int entry = probeTablebase(&tablebase, state);
+        if (entry > TB_DRAW && tablebaseEntryHolds(entry, ctx->plies_left, ply))
+        {
+            return tablebaseScore(entry, ply);
+        }
+    }
+    if (depth == 0)
+    {
+        return evaluate(state);
+    }
+
+    // A position searched before may settle this node, or at least tell which move to try first.
+    MoveList list;
+    generateMoves(&state->board, state->side, &list);
+    int alpha_orig = alpha;
+    // Symmetric positions share one entry, whose move is stored as seen in the canonical image.
+    int symmetry;
+    uint64_t key = canonicalHash(state, &symmetry);
+    TTData entry;
+    if (ttProbe(ctx->tt, key, &entry))
+    {
+        if (entry.depth >= depth)
+        {
+            int score = scoreFromTable(entry.score, ply);
+            if (entry.bound == BOUND_EXACT
+                || (entry.bound == BOUND_LOWER && score >= beta)
+                || (entry.bound == BOUND_UPPER && score <= alpha))
+            {
+                return score;
+            }
+        }
+        orderFirst(&list, transformMove(entry.best, inverse_symmetry[symmetry]));
+    }
+
+    int best = -WIN_SCORE - 1;
+    Move best_move = list.moves[0];
+    for (int i = 0; i < list.count; i++)
+    {
+        UndoRecord undo;
+        makeMove(state, list.moves[i], &undo);
+        int score = -negamax(ctx, state, depth - 1, -beta, -alpha, ply + 1);
+        unmakeMove(state, &undo);
+        if (ctx->stopped)
+        {
+            // The score of an interrupted search means nothing.
+            return 0;
+        }
+        if (score > best)
+        {
+            best = score;
+            best_move = list.moves[i];
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+        }
+        if (alpha >= beta)
+        {
+            // The opponent will avoid this line, no need to look further.
+            break;
+        }
+    }
+
+    int bound = (best <= alpha_orig) ? BOUND_UPPER : (best >= beta) ? BOUND_LOWER : BOUND_EXACT;
+    ttStore(ctx->tt, key, depth, bound, best, ply, transformMove(best_move, symmetry));
+    return best;
+}
+
+// Function that searches every root move 'depth' plies deep.
+// Returns 0 if the deadline stopped the search first, leaving 'best' and 'score' untouched.
+int searchRoot(SearchContext* ctx, GameState* state, int depth, Move* best, int* score)
+{
+    MoveList list;
+    generateMoves(&state->board, state->side, &list);
+    // Helper threads start on different root moves, so they fill the table with different lines.
+    if (ctx->id > 0 && list.count > 1)
+    {
+        int shift = ctx->id % list.count;
+        Move rotated[MAX_MOVES];
+        for (int i = 0; i < list.count; i++)
+        {
+            rotated[i] = list.moves[(i + shift) % list.count];
+        }
+        memcpy(list.moves, rotated, list.count * sizeof(Move));
+    }
+    // The best move of the previous depth is tried first.
+    int symmetry;
+    uint64_t key = canonicalHash(state, &symmetry);
+    TTData entry;
+    if (ttProbe(ctx->tt, key, &entry))
+    {
+        orderFirst(&list, transformMove(entry.best, inverse_symmetry[symmetry]));
+    }
+
+    Move root_best = list.moves[0];
+    int alpha = -WIN_SCORE - 1;
+    for (int i = 0; i < list.count; i++)
+    {
+        UndoRecord undo;
+        makeMove(state, list.moves[i], &undo);
+        int child_score = -negamax(ctx, state, depth - 1, -WIN_SCORE - 1, -alpha, 1);
+        unmakeMove(state, &undo);
+        if (ctx->stopped)
+        {
+            return 0;
+        }
+        if (child_score > alpha)
+        {
+            alpha = child_score;
+            root_best = list.moves[i];
+        }
+    }
+    ttStore(ctx->tt, key, depth, BOUND_EXACT, alpha, 0, transformMove(root_best, symmetry));
+    *best = root_best;
+    *score = alpha;
+    return 1;
+}
+
+// Work of one search thread: iterative deepening on its own copy of the root.
+typedef struct SearchThread
+{
+    pthread_t handle;
+    SearchContext ctx;
+    const GameState* state;
+    int max_depth;
+    uint64_t start;
+    SearchResult result;
+} SearchThread;
+
+/*
+ * Iterative deepening: the root is searched to depth 1, 2, 3, ... up to 'max_depth'.
+ * Every iteration leaves its best move in the transposition table, where it orders the next one.
+ * The search stops when the deadline passes or the main thread raises the stop flag, and keeps
+ * the best move of the last depth it completed.
+*/
+void* runSearchThread(void* arg)
+{
+    SearchThread* t = (SearchThread*)arg;
+    SearchResult* result = &t->result;
+    // Every thread makes and unmakes its moves on a copy of its own.
+    GameState state = *t->state;
+    for (int depth = 1; depth <= t->max_depth; depth++)
+    {
+        // Odd helper threads run one ply ahead of the others.
+        int searched = depth + ((t->ctx.id & 1) && depth < t->max_depth);
+        Move best;
+        int score;
+        if (!searchRoot(&t->ctx, &state, searched, &best, &score))
+        {
+            break;
+        }
+        result->best = best;
+        result->score = score;
+        result->depth = searched;
+        result->depth_nanoseconds[searched] = nowNanoseconds() - t->start;
+        if (score > WIN_BOUND || score < -WIN_BOUND)
+        {
+            // The outcome is already decided; a deeper search cannot change it.
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Lazy SMP search.
+ * Every thread runs its own iterative deepening on the same root, and they share nothing but the
+ * transposition table and the stop flag. What one thread stores cuts the search of the others, so
+ * together they reach deeper than one thread would in the same time. The answer is taken from the
+ * thread that completed the deepest iteration.
+ * Raising 'stop' from another thread ends the search early, with the best move found so far.
+ * 'turns_left' is the number of plies to the turn limit (0 for no limit); the tablebase is only
+ * trusted where the game ends before it.
+ * The caller guarantees that the player to move has at least one move.
+*/
+void searchPosition(TranspositionTable* tt, const GameState* state, int max_depth, int movetime_ms, int threads,
+    int turns_left, atomic_int* stop, SearchResult* result)
+{
+    uint64_t start = nowNanoseconds();
+    memset(result, 0, sizeof(SearchResult));
+    if (tablebaseMove(state, turns_left, result))
+    {
+        result->nanoseconds = nowNanoseconds() - start;
+        return;
+    }
+    PROFILE_ALLOCATION();
+    SearchThread* workers = (SearchThread*)calloc(threads, sizeof(SearchThread));
+    // Entries from earlier moves are kept for their scores but lose their protection.
+    tt->generation++;
+
+    // Until depth 1 completes, any legal move is the answer.
+    MoveList list;
+    generateMoves(&state->board, state->side, &list);
+    for (int i = 0; i < threads; i++)
+    {
+        SearchThread* t = &workers[i];
+        SearchContext ctx = { tt, 0, 0, stop, 0, i, turns_left };
+        if (movetime_ms > 0)
+        {
+            ctx.deadline = start + (uint64_t)movetime_ms * 1000000u;
+        }
+        t->ctx = ctx;
+        t->state = state;
+        t->max_depth = max_depth;
+        t->start = start;
+        memset(&t->result, 0, sizeof(SearchResult));
+        t->result.best = list.moves[0];
+    }
+
+    // Helper threads are started first; the calling thread is the main search thread.
+    int started = 1;
+    while (started < threads && pthread_create(&workers[started].handle, NULL, runSearchThread, &workers[started]) == 0)
+    {
+        started++;
+    }
+    runSearchThread(&workers[0]);
+    atomic_store(stop, 1);
+    for (int i = 1; i < started; i++)
+    {
+        pthread_join(workers[i].handle, NULL);
+    }
+
+    *result = workers[0].result;
+    result->nodes = 0;
+    result->threads = started;
+    for (int i = 0; i < started; i++)
+    {
+        SearchResult* r = &workers[i].result;
+        result->nodes += workers[i].ctx.nodes;
+        if (r->depth > result->depth)
+        {
+            result->best = r->best;
+            result->score = r->score;
+            result->depth = r->depth;
+        }
+        // A depth counts as reached when the first thread completes it.
+        for (int d = 1; d <= r->depth; d++)
+        {
+            if (r->depth_nanoseconds[d] && (!result->depth_nanoseconds[d] || r->depth_nanoseconds[d] < result->depth_nanoseconds[d]))
+            {
+                result->depth_nanoseconds[d] = r->depth_nanoseconds[d];
+            }
+        }
+    }
+    result->nanoseconds = nowNanoseconds() - start;
+    free(workers);
+}
+
+// Function that searches for the best move with iterative deepening, to 'max_depth' or until the
+// time budget runs out, 'turns_left' plies before the turn limit (0 for no limit).
+void searchBestMove(TranspositionTable* tt, const GameState* state, int max_depth, int movetime_ms, int threads,
+    int turns_left, SearchResult* result)
+{
+    atomic_int stop;
+    atomic_init(&stop, 0);
+    searchPosition(tt, state, max_depth, movetime_ms, threads, turns_left, &stop, result);
+}
+
+/*
+ * Endgame solver.
+ * Once the last turn is played the game goes to the player with more valid moves, not to the one who
+ * avoided getting stuck. The general search scores its horizon by the mobility margin but does not know
+ * where the limit lies, so near the end it plays for the wrong goal. When the turns left fit the engine's
+ * budget, the solver searches exactly to the limit instead. It scores each line by how the game really
+ * ends: a loss for the player left without a move, otherwise the comparison when the turns run out.
+ * Its scores are only wins, draws and losses, so alpha-beta cuts far more than in the general search.
+*/
+
+// The most plies the solver takes on under a time budget.
+#define SOLVER_MAX_PLIES 24
+
+// Function that returns the key that sets the solver's table entries apart: the same position is worth
+// something else with another number of plies to go, and the general search's entries mean neither.
+static inline uint64_t solverKey(int plies_left)
+{
+    uint64_t key = (uint64_t)(plies_left + 1) * UINT64_C(0xD6E8FEB86659FD93);
+    return key ^ (key >> 32);
+}
+
+// Function that returns the exact result of the state 'plies_left' plies before the turn limit, for the
+// player to move: WIN_SCORE less the plies to the end for a win, the negative of that for a loss, 0 for a draw.
+int solveNegamax(SearchContext* ctx, GameState* state, int plies_left, int alpha, int beta, int ply)
+{
+    ctx->nodes++;
+    if ((ctx->nodes % CLOCK_CHECK_NODES) == 0
+        && ((ctx->deadline && nowNanoseconds() >= ctx->deadline) || atomic_load_explicit(ctx->stop, memory_order_relaxed)))
+    {
+        ctx->stopped = 1;
+    }
+    if (ctx->stopped)
+    {
+        return 0;
+    }
+    if (plies_left == 0)
+    {
+        // The turns have run out: the player with more valid moves wins, even one who is stuck now.
+        int margin = evaluate(state);
+        return (margin > 0) ? WIN_SCORE - ply : (margin < 0) ? -WIN_SCORE + ply : 0;
+    }
+    if (isGameOver(state))
+    {
+        return -WIN_SCORE + ply;
+    }
+
+    MoveList list;
+    generateMoves(&state->board, state->side, &list);
+    int alpha_orig = alpha;
+    int symmetry;
+    uint64_t key = canonicalHash(state, &symmetry) ^ solverKey(plies_left);
+    TTData entry;
+    if (ttProbe(ctx->tt, key, &entry))
+    {
+        // The key holds the plies left, so every entry found is as deep as this search.
+        int score = scoreFromTable(entry.score, ply);
+        if (entry.bound == BOUND_EXACT
+            || (entry.bound == BOUND_LOWER && score >= beta)
+            || (entry.bound == BOUND_UPPER && score <= alpha))
+        {
+            return score;
+        }
+        orderFirst(&list, transformMove(entry.best, inverse_symmetry[symmetry]));
+    }
+
+    int best = -WIN_SCORE - 1;
+    Move best_move = list.moves[0];
+    for (int i = 0; i < list.count; i++)
+    {
+        UndoRecord undo;
+        makeMove(state, list.moves[i], &undo);
+        int score = -solveNegamax(ctx, state, plies_left - 1, -beta, -alpha, ply + 1);
+        unmakeMove(state, &undo);
+        if (ctx->stopped)
+        {
+            return 0;
+        }
+        if (score > best)
+        {
+            best = score;
+            best_move = list.moves[i];
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+        }
+        if (alpha >= beta)
+        {
+            break;
+        }
+    }
+
+    int bound = (best <= alpha_orig) ? BOUND_UPPER : (best >= beta) ? BOUND_LOWER : BOUND_EXACT;
+    ttStore(ctx->tt, key, plies_left, bound, best, ply, transformMove(best_move, symmetry));
+    return best;
+}
+
+// Function that tells whether the solver takes on a position with 'turns_left' turns to go (0 for no limit):
+// when the limit is within the depth of a fixed-depth engine, or within SOLVER_MAX_PLIES under a time budget.
+int endgameSolverApplies(const EngineConfig* engine, int turns_left)
+{
+    return engine->kind == ENGINE_ALPHABETA && turns_left > 0
+        && turns_left <= (engine->movetime_ms > 0 ? SOLVER_MAX_PLIES : engine->depth);
+}
+
+// Function that plays the position out exactly to the turn limit, 'turns_left' plies away, and fills in
+// 'result' with the best move and its result. Returns 0 if 'deadline' (when not 0) passed first, or
+// another thread raised 'stop'.
+// The caller guarantees that the player to move has at least one move.
+int solveEndgame(TranspositionTable* tt, const GameState* state, int turns_left, uint64_t deadline, atomic_int* stop,
+    SearchResult* result)
+{
+    uint64_t start = nowNanoseconds();
+    SearchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.tt = tt;
+    ctx.deadline = deadline;
+    ctx.stop = stop;
+    tt->generation++;
+
+    GameState root = *state;
+    MoveList list;
+    generateMoves(&root.board, root.side, &list);
+    int symmetry;
+    TTData entry;
+    if (ttProbe(tt, canonicalHash(&root, &symmetry) ^ solverKey(turns_left), &entry))
+    {
+        orderFirst(&list, transformMove(entry.best, inverse_symmetry[symmetry]));
+    }
+    int alpha = -WIN_SCORE - 1;
+    Move best = list.moves[0];
+    for (int i = 0; i < list.count; i++)
+    {
+        UndoRecord undo;
+        makeMove(&root, list.moves[i], &undo);
+        int score = -solveNegamax(&ctx, &root, turns_left - 1, -WIN_SCORE - 1, -alpha, 1);
+        unmakeMove(&root, &undo);
+        if (ctx.stopped)
+        {
+            return 0;
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+            best = list.moves[i];
+        }
+    }
+    memset(result, 0, sizeof(SearchResult));
+    result->best = best;
+    result->score = alpha;
+    result->depth = turns_left;
+    result->nodes = ctx.nodes;
+    result->threads = 1;
+    result->solved = 1;
+    result->nanoseconds = nowNanoseconds() - start;
+    return 1;
+}
+
+/*
+ * Monte Carlo tree search.
+ * Every iteration walks down the tree by UCT (the child with the best win rate plus an
+ * exploration bonus for rarely tried moves), adds the children of the leaf it reaches, plays the
+ * game out with random moves, and credits the result to every node on the way down. The move
+ * tried most often at the root is played. The nodes come from one pool allocated per search,
+ * and a playout only touches a copy of the board on the stack, so nothing is allocated per iteration.
+*/
+
+// Plies a playout runs for, counted from the root, when the game has no turn limit: the length of a default game.
+#define MCTS_PLAYOUT_PLIES 40
+// Weight of the exploration bonus in UCT.
+#define MCTS_EXPLORATION 1.4
+// Deepest path through the tree that an iteration follows.
+#define MCTS_MAX_PATH 256
+// Playouts between two looks at the clock.
+#define MCTS_CLOCK_CHECK 64
+
+typedef struct MctsNode
+{
+    // The move that leads here, made by the player who is not to move here.
+    Move move;
+    uint16_t child_count;
+    // Pool index of the first child, or 0 while the node has not been expanded (only the root is node 0).
+    uint32_t first_child;
+    uint32_t visits;
+    // Results for the player who made 'move', counted twice over: 2 a win, 1 a draw.
+    uint32_t half_points;
+} MctsNode;
+
+// Function that plays random moves until the player to move is stuck or 'plies' moves were made,
+// and returns the winner: X_INDEX, O_INDEX, or DRAW when the mobilities are equal at the end.
+int randomPlayout(BitBoard board, int side, int plies, Random* rng)
+{
+    MoveList list;
+    for (int ply = 0; ply < plies; ply++)
+    {
+        generateMoves(&board, side, &list);
+        if (list.count == 0)
+        {
+            return !side;
+        }
+        Move move = list.moves[randomBelow(rng, list.count)];
+        movePiece(&board, side, move.from, move.to);
+        side = !side;
+    }
+    int x_moves = countPlayerValidMoves(&board, PLAYER_ONE);
+    int o_moves = countPlayerValidMoves(&board, PLAYER_TWO);
+    return (x_moves == o_moves) ? DRAW : (x_moves > o_moves) ? X_INDEX : O_INDEX;
+}
+
+// Function that picks the child of 'parent' to walk into next by UCT.
+uint32_t selectChild(const MctsNode* pool, const MctsNode* parent)
+{
+    double log_visits = log((double)parent->visits);
+    uint32_t best = parent->first_child;
+    double best_value = -1;
+    for (uint32_t c = parent->first_child; c < parent->first_child + parent->child_count; c++)
+    {
+        const MctsNode* child = &pool[c];
+        if (child->visits == 0)
+        {
+            // Every move is tried once before any is tried twice.
+            return c;
+        }
+        double value = child->half_points / (2.0 * child->visits) + MCTS_EXPLORATION * sqrt(log_visits / child->visits);
+        if (value > best_value)
+        {
+            best_value = value;
+            best = c;
+        }
+    }
+    return best;
+}
+
+/*
+ * Function that chooses a move by Monte Carlo tree search: 'playouts' iterations, or as many as
+ * fit in 'movetime_ms' when that is set, with at most 'max_nodes' tree nodes.
+ * With a turn limit 'turns_left' plies away (0 for none), neither the tree nor the playouts go past
+ * it, and every playout that reaches it is scored by mobility there, as the game is.
+ * The caller guarantees that the player to move has at least one move.
+*/
+void searchMcts(const GameState* state, int playouts, int movetime_ms, int max_nodes, int turns_left, Random* rng,
+    SearchResult* result)
+{
+    uint64_t start = nowNanoseconds();
+    uint64_t deadline = (movetime_ms > 0) ? start + (uint64_t)movetime_ms * 1000000u : 0;
+    memset(result, 0, sizeof(SearchResult));
+    result->threads = 1;
+
+    MoveList root_moves;
+    generateMoves(&state->board, state->side, &root_moves);
+    result->best = root_moves.moves[0];
+    // The root and its children must fit, or the search has nothing to count on.
+    if (max_nodes < root_moves.count + 1)
+    {
+        max_nodes = root_moves.count + 1;
+    }
+    PROFILE_ALLOCATION();
+    MctsNode* pool = (MctsNode*)malloc((size_t)max_nodes * sizeof(MctsNode));
+    if (pool == NULL)
+    {
+        printf("ERROR: Could not allocate %d tree nodes. \n", max_nodes);
+        return;
+    }
+    memset(&pool[0], 0, sizeof(MctsNode));
+    uint32_t used = 1;
+
+    // Plies from the root to the end of every playout.
+    int horizon = (turns_left > 0) ? turns_left : MCTS_PLAYOUT_PLIES;
+    uint64_t iterations = 0;
+    uint32_t path[MCTS_MAX_PATH];
+    while (deadline ? (iterations % MCTS_CLOCK_CHECK != 0 || nowNanoseconds() < deadline) : iterations < (uint64_t)playouts)
+    {
+        BitBoard board = state->board;
+        int side = state->side;
+        int length = 0;
+        uint32_t node = 0;
+        path[length++] = node;
+
+        // Selection: down the tree while the nodes are expanded, stopping at the turn limit.
+        while (pool[node].child_count > 0 && length < MCTS_MAX_PATH && (turns_left == 0 || length <= turns_left))
+        {
+            node = selectChild(pool, &pool[node]);
+            movePiece(&board, side, pool[node].move.from, pool[node].move.to);
+            side = !side;
+            path[length++] = node;
+        }
+
+        // Expansion: a leaf gets its children on its second visit, while the pool has room.
+        if (pool[node].first_child == 0 && (node == 0 || pool[node].visits > 0) && length < MCTS_MAX_PATH
+            && (turns_left == 0 || length <= turns_left))
+        {
+            MoveList list;
+            generateMoves(&board, side, &list);
+            if (used + (uint32_t)list.count <= (uint32_t)max_nodes)
+            {
+                pool[node].first_child = used;
+                pool[node].child_count = (uint16_t)list.count;
+                for (int i = 0; i < list.count; i++)
+                {
+                    MctsNode* child = &pool[used++];
+                    child->move = list.moves[i];
+                    child->child_count = 0;
+                    child->first_child = 0;
+                    child->visits = 0;
+                    child->half_points = 0;
+                }
+                if (list.count > 0)
+                {
+                    node = pool[node].first_child;
+                    movePiece(&board, side, pool[node].move.from, pool[node].move.to);
+                    side = !side;
+                    path[length++] = node;
+                }
+            }
+        }
+
+        // Simulation, then back-propagation. The player who made a node's move is the one not to move there.
+        int plies = horizon - (length - 1);
+        int winner = randomPlayout(board, side, plies > 0 ? plies : 0, rng);
+        for (int i = length - 1; i >= 0; i--)
+        {
+            MctsNode* n = &pool[path[i]];
+            n->visits++;
+            n->half_points += (winner == DRAW) ? 1 : (winner != side) ? 2 : 0;
+            side = !side;
+        }
+        iterations++;
+    }
+
+    // The most visited move is the most trusted one.
+    uint32_t best = pool[0].first_child;
+    for (uint32_t c = pool[0].first_child; c < pool[0].first_child + pool[0].child_count; c++)
+    {
+        if (pool[c].visits > pool[best].visits)
+        {
+            best = c;
+        }
+    }
+    result->best = pool[best].move;
+    // The expected result of the move for the computer, in thousandths.
+    result->score = pool[best].visits ? (int)(500.0 * pool[best].half_points / pool[best].visits) : 500;
+    result->playouts = iterations;
+    result->tree_nodes = used;
+    result->nanoseconds = nowNanoseconds() - start;
+    free(pool);
+}
+
+// Function that picks a random move of the piece with the most moves (the original computer player).
+Move chooseGreedyMove(const GameState* state, Random* rng)
+{
+    const BitBoard* board = &state->board;
+    uint64_t empty = emptyCells(board);
+    // The cell of the piece that has maximum moves possible!
+    int max_cell = state->piece_cells[state->side][0];
+    int max = 0;
+    for (int p = 0; p < state->piece_count[state->side]; p++)
+    {
+        int cell = state->piece_cells[state->side][p];
+        int count = popCount(stepTargets(UINT64_C(1) << cell, empty));
+        if (count > max)
+        {
+            max = count;
+            max_cell = cell;
+        }
+    }
+
+    // We enumerate all the valid moves for the piece at that position.
+    MoveList list;
+    generatePieceMoves(board, max_cell, &list);
+    // The computer randomly chooses a move.
+    return list.moves[randomBelow(rng, list.count)];
+}
+
+// Function that chooses a move with the configured engine, without printing anything.
+// 'turns_left' is the number of turns before the turn limit, or 0 when there is none.
+// 'result' is filled in for searching engines; the greedy engine leaves its depth at 0.
+Move selectMove(TranspositionTable* tt, const GameState* state, const EngineConfig* engine, int turns_left, Random* rng,
+    SearchResult* result)
+{
+    PROFILE_BEGIN(PROFILE_SELECT_MOVE);
+    if (engine->kind == ENGINE_GREEDY)
+    {
+        result->depth = 0;
+        result->best = chooseGreedyMove(state, rng);
+    }
+    else if (engine->kind == ENGINE_MCTS)
+    {
+        searchMcts(state, engine->playouts, engine->movetime_ms, engine->mcts_nodes, turns_left, rng, result);
+        // A playout is the Monte Carlo engine's node.
+        PROFILE_NODES(PROFILE_SELECT_MOVE, result->playouts);
+    }
+    else {
+        int movetime_ms = engine->movetime_ms;
+        int solved = 0;
+        if (endgameSolverApplies(engine, turns_left))
+        {
+            // Under a time budget the solver gets half of it, and the general search what is left if it
+            // does not finish.
+            uint64_t start = nowNanoseconds();
+            uint64_t deadline = (movetime_ms > 0) ? start + (uint64_t)movetime_ms * 500000u : 0;
+            atomic_int stop;
+            atomic_init(&stop, 0);
+            solved = solveEndgame(tt, state, turns_left, deadline, &stop, result);
+            int spent_ms = (int)((nowNanoseconds() - start) / 1000000u);
+            movetime_ms = (movetime_ms > spent_ms + 1) ? movetime_ms - spent_ms : 1;
+        }
+        if (!solved)
+        {
+            searchBestMove(tt, state, engine->depth, movetime_ms, engine->threads, turns_left, result);
+        }
+        PROFILE_NODES(PROFILE_SELECT_MOVE, result->nodes);
+    }
+    PROFILE_END(PROFILE_SELECT_MOVE);
+    return result->best;
+}
+
+// Function that renders what the engine found and how fast.
+void renderSearchResult(RenderBuffer* out, const EngineConfig* engine, const SearchResult* result)
+{
+    if (engine->kind == ENGINE_GREEDY)
+    {
+        return;
+    }
+    if (engine->kind == ENGINE_MCTS)
+    {
+        double seconds = result->nanoseconds / 1e9;
+        renderf(out, "MCTS: %llu playouts in %.3f s (%.0f playouts/sec), %d tree nodes, expected score %.1f%%\n",
+            (unsigned long long)result->playouts, seconds, seconds > 0 ? result->playouts / seconds : 0.0, result->tree_nodes,
+            result->score / 10.0);
+        return;
+    }
+    if (result->tablebase)
+    {
+        int distance = (result->score > 0) ? WIN_SCORE - result->score : WIN_SCORE + result->score;
+        renderf(out, "Tablebase: the computer %s in %d plies\n", result->score > 0 ? "wins" : "loses", distance);
+        return;
+    }
+    if (result->solved)
+    {
+        double seconds = result->nanoseconds / 1e9;
+        renderf(out, "Endgame: solved to the turn limit %d plies ahead, the computer %s (%llu nodes in %.3f s)\n",
+            result->depth, result->score > 0 ? "wins" : result->score < 0 ? "loses" : "draws",
+            (unsigned long long)result->nodes, seconds);
+        return;
+    }
+    double seconds = result->nanoseconds / 1e9;
+    renderf(out, "Search: reached depth %d, score %d, %llu nodes in %.3f s on %d thread(s) (%.0f nodes/sec)\n", result->depth,
+        result->score, (unsigned long long)result->nodes, seconds, result->threads, seconds > 0 ? result->nodes / seconds : 0.0);
+}
+
+// Function that chooses the computer's move with the configured engine and renders the search speed.
+Move chooseComputerMove(RenderBuffer* out, TranspositionTable* tt, const GameState* state, const EngineConfig* engine,
+    int turns_left, Random* rng)
+{
+    SearchResult result;
+    selectMove(tt, state, engine, turns_left, rng, &result);
+    renderSearchResult(out, engine, &result);
+    return result.best;
+}
+
+/*
+ * Pondering.
+ * While the user thinks, a background thread searches the position the computer expects to face
+ * next: the one after the user's move that the last search expected (the best move stored for the
+ * user's position). If the user plays that move, the search goes on as the computer's own and its
+ * result is played; otherwise it is stopped and thrown away, and only what it left in the
+ * transposition table is reused. Without an expected move the user's position itself is searched,
+ * which fills the table with replies to every move the user can make.
+ * Only the alpha-beta engine ponders.
+*/
+typedef struct Ponder
+{
+    pthread_t thread;
+    // Set while a background search runs or has finished without being collected.
+    int running;
+    atomic_int stop;
+    // The move the user is expected to play, when there is one.
+    int has_expected;
+    Move expected;
+    // The searched position, owned by the thread while it runs.
+    GameState root;
+    // Plies from the searched position to the turn limit, or 0 for no limit.
+    int turns_left;
+    TranspositionTable* tt;
+    EngineConfig engine;
+    uint64_t start;
+    SearchResult result;
+    // Set when the user played the expected move: 'result' is then the computer's move, found
+    // 'latency' nanoseconds after the user moved.
+    int hit;
+    uint64_t latency;
+} Ponder;
+
+void* runPonder(void* arg)
+{
+    Ponder* ponder = (Ponder*)arg;
+    // With a time budget the search runs until it is stopped; the budget is applied once the user moves.
+    if (endgameSolverApplies(&ponder->engine, ponder->turns_left))
+    {
+        // Near the limit the computer's move comes from the solver, so the pondering solves too.
+        // An unfinished solve leaves 'solved' clear, and the move is then chosen afresh.
+        if (!solveEndgame(ponder->tt, &ponder->root, ponder->turns_left, 0, &ponder->stop, &ponder->result))
+        {
+            memset(&ponder->result, 0, sizeof(SearchResult));
+        }
+        return NULL;
+    }
+    searchPosition(ponder->tt, &ponder->root, ponder->engine.depth, 0, ponder->engine.threads, ponder->turns_left, &ponder->stop,
+        &ponder->result);
+    return NULL;
+}
+
+// Function that starts pondering on the user's turn, 'turns_left' plies before the turn limit (0 for no limit).
+void startPonder(Ponder* ponder, TranspositionTable* tt, const GameState* state, const EngineConfig* engine, int turns_left)
+{
+    ponder->hit = 0;
+    // After the user's move on the last turn the game is over, and there is nothing to ponder.
+    if (engine->kind != ENGINE_ALPHABETA || ponder->running || turns_left == 1)
+    {
+        return;
+    }
+    ponder->tt = tt;
+    ponder->engine = *engine;
+    ponder->root = *state;
+    ponder->turns_left = turns_left;
+    ponder->has_expected = 0;
+    int symmetry;
+    TTData entry;
+    if (ttProbe(tt, canonicalHash(state, &symmetry), &entry))
+    {
+        Move expected = transformMove(entry.best, inverse_symmetry[symmetry]);
+        uint64_t from = UINT64_C(1) << expected.from;
+        // The entry may belong to another position with the same key, so the move is checked.
+        if ((state->board.pieces[state->side] & from)
+            && (stepTargets(from, emptyCells(&state->board)) & (UINT64_C(1) << expected.to)))
+        {
+            applyMove(&ponder->root, expected);
+            if (isGameOver(&ponder->root))
+            {
+                // The computer would have no move to search.
+                ponder->root = *state;
+            }
+            else {
+                ponder->expected = expected;
+                ponder->has_expected = 1;
+                ponder->turns_left = (turns_left > 0) ? turns_left - 1 : 0;
+            }
+        }
+    }
+    atomic_init(&ponder->stop, 0);
+    ponder->start = nowNanoseconds();
+    ponder->running = (pthread_create(&ponder->thread, NULL, runPonder, ponder) == 0);
+}
+
+// Function that ends pondering. 'played' is the user's move, or NULL when the pondered search is of
+// no use any more (a takeback, or the end of the game).
+void finishPonder(Ponder* ponder, const Move* played)
+{
+    if (!ponder->running)
+    {
+        return;
+    }
+    uint64_t moved = nowNanoseconds();
+    ponder->hit = played != NULL && ponder->has_expected && played->from == ponder->expected.from
+        && played->to == ponder->expected.to;
+    if (ponder->hit && ponder->engine.movetime_ms > 0)
+    {
+        // The time spent pondering counts toward the budget; only the rest of it is waited out.
+        uint64_t budget = (uint64_t)ponder->engine.movetime_ms * 1000000u;
+        uint64_t spent = moved - ponder->start;
+        if (spent < budget)
+        {
+            sleepNanoseconds(budget - spent);
+        }
+    }
+    if (!ponder->hit || ponder->engine.movetime_ms > 0)
+    {
+        atomic_store(&ponder->stop, 1);
+    }
+    // On a hit without a time budget the search is left to finish its depth.
+    pthread_join(ponder->thread, NULL);
+    ponder->running = 0;
+    ponder->latency = nowNanoseconds() - moved;
+}
+
+/***************************************************
+ * Command line options.
+****************************************************/
+
+// Default pieces per player and turn limit of a self-play game.
+#define DEFAULT_PIECES 6
+#define DEFAULT_TURNS 40
+
+// What the program does once started.
+#define MODE_PLAY 0
+#define MODE_SPEEDUP 1
+#define MODE_SELFPLAY 2
+#define MODE_BENCH 3
+#define MODE_PERFT 4
+#define MODE_TABLEBASE 5
+#define MODE_ANALYZE 6
+#define MODE_REPLAY 7
+#define MODE_SERVER 8
+#define MODE_TOURNAMENT 9
+
+// The most engine configurations a tournament can hold.
+#define TOURNAMENT_MAX_ENTRANTS 8
+
+// Everything that can be set from the command line.
+typedef struct Options
+{
+    // One of the MODE_* constants.
+    int mode;
+    // The engine playing the computer's side.
+    EngineConfig engine;
+    // Self-play settings: number of games, pieces per player, turn limit, seed, and the engine of each side.
+    long games;
+    int pieces;
+    int turns;
+    // The width and height of the board of an interactive or self-play game; SIDE unless --size says otherwise.
+    int size;
+    uint64_t seed;
+    // Whether --seed was given; otherwise an interactive game takes its seed from the clock.
+    int seed_given;
+    EngineConfig engines[2];
+    // Deepest perft count to print.
+    int perft_depth;
+    // How the interactive game is shown: one of the OUTPUT_* constants.
+    int output;
+    // The file of recorded answers to play from ("-" for stdin), or NULL to play with the user.
+    const char* script;
+    // The tablebase file, whether it was named on the command line, and the pieces per side to generate.
+    const char* tb_file;
+    int tb_file_given;
+    int tb_pieces;
+    // Whether the computer searches while the user thinks.
+    int ponder;
+    // The file of positions to analyze ("-" for stdin), and the number of positions searched at once.
+    const char* analyze;
+    int jobs;
+    // The game archive that finished games are appended to, or NULL; and the archive to replay.
+    const char* record;
+    const char* replay;
+    // Tournament settings: the openings each pair of entrants plays twice, the entrants, and the
+    // bounds of the sequential test when it is on.
+    long openings;
+    EngineConfig entrants[TOURNAMENT_MAX_ENTRANTS];
+    int entrant_count;
+    int sprt;
+    double sprt_elo[2];
+    // The file the instrumentation writes to, or NULL.
+    const char* profile;
+} Options;
+
+/***************************************************
+ * Game records.
+ *
+ * Finished games are appended to a binary archive: the start position and one
+ * byte per move, so a 40-turn game takes about 60 bytes instead of the
+ * kilobytes of its text log. A replay rebuilds every game of an archive and
+ * checks each move and each result.
+ *
+ * The archive starts with the 4-byte magic and a version byte. Each game is
+ * RECORD_GAME_START, the 'X' and 'O' bitboards (8 bytes each, little-endian)
+ * and the side to move, then its moves, then RECORD_GAME_END and the result.
+ * A move byte is the moving piece's cell, numbered row by row from 0, times 4
+ * plus its direction.
+****************************************************/
+
+#define RECORD_MAGIC 0x52474F58u
+#define RECORD_VERSION 1
+#define RECORD_GAME_START 0xFE
+#define RECORD_GAME_END 0xFF
+// The result byte is the winner (0 for 'X', 1 for 'O', 2 for a draw), with this flag when the player to move was stuck.
+#define RECORD_STUCK 0x80
+#define RECORD_DRAW 2
+// Bytes of the file read at a time by a replay.
+#define RECORD_CHUNK 65536
+// Errors a replay describes before it only counts them.
+#define RECORD_MAX_REPORTS 10
+
+#if SIDE * SIDE * 4 > RECORD_GAME_START
+#error "A move of a board this large does not fit in a record byte"
+#endif
+
+// The step of each direction, in the order of the two low bits of a move byte.
+static const int record_steps[4] = { -STRIDE, STRIDE, -1, 1 };
+
+typedef struct GameRecorder
+{
+    FILE* file;
+    // Games written in this run.
+    uint64_t games;
+} GameRecorder;
+
+// Function that writes 'bytes' bytes of 'value', lowest first.
+void writeLittleEndian(FILE* file, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        putc((int)((value >> (8 * i)) & 0xFF), file);
+    }
+}
+
+// Function that opens an archive for appending, and writes its header if it is new. Returns 0 on failure.
+int openRecorder(GameRecorder* recorder, const char* path)
+{
+    recorder->games = 0;
+    recorder->file = fopen(path, "ab");
+    if (recorder->file == NULL)
+    {
+        return 0;
+    }
+    // The moves are small writes; a large buffer turns them into a few big ones.
+    setvbuf(recorder->file, NULL, _IOFBF, RECORD_CHUNK);
+    fseek(recorder->file, 0, SEEK_END);
+    if (ftell(recorder->file) == 0)
+    {
+        writeLittleEndian(recorder->file, RECORD_MAGIC, 4);
+        putc(RECORD_VERSION, recorder->file);
+    }
+    return 1;
+}
+
+// Function that writes what is left in the buffer and closes the archive. Returns 0 if anything failed to write.
+int closeRecorder(GameRecorder* recorder)
+{
+    int failed = ferror(recorder->file);
+    failed |= fclose(recorder->file);
+    recorder->file = NULL;
+    return !failed;
+}
+
+// Function that starts the record of a game from its start position.
+void recordGameStart(GameRecorder* recorder, const BitBoard* board, int side)
+{
+    putc(RECORD_GAME_START, recorder->file);
+    writeLittleEndian(recorder->file, board->pieces[X_INDEX], 8);
+    writeLittleEndian(recorder->file, board->pieces[O_INDEX], 8);
+    putc(side, recorder->file);
+}
+
+// Function that appends one move to the game being recorded.
+// Only a one-step slide has a code, so any other move is refused and nothing is written.
+int recordMove(GameRecorder* recorder, Move move)
+{
+    int direction = 0;
+    while (direction < 4 && move.from + record_steps[direction] != move.to)
+    {
+        direction++;
+    }
+    if (direction == 4)
+    {
+        printf("ERROR: Only a move to a neighbouring cell can be recorded. \n");
+        return 0;
+    }
+    putc((CELL_ROW(move.from) * SIDE + CELL_COL(move.from)) * 4 + direction, recorder->file);
+    return 1;
+}
+
+// Function that ends the record of a game with its result. The file is not flushed: the buffer fills over many games.
+void recordGameEnd(GameRecorder* recorder, int winner, int stuck)
+{
+    putc(RECORD_GAME_END, recorder->file);
+    putc(((winner == DRAW) ? RECORD_DRAW : winner) | (stuck ? RECORD_STUCK : 0), recorder->file);
+    recorder->games++;
+}
+
+// A replay reads the archive a block at a time.
+typedef struct RecordReader
+{
+    FILE* file;
+    uint8_t data[RECORD_CHUNK];
+    size_t position;
+    size_t end;
+    // Offset in the file of data[0].
+    uint64_t offset;
+} RecordReader;
+
+// Function that returns the next byte of the archive, or -1 at its end.
+static inline int nextRecordByte(RecordReader* reader)
+{
+    if (reader->position == reader->end)
+    {
+        reader->offset += reader->end;
+        reader->end = fread(reader->data, 1, RECORD_CHUNK, reader->file);
+        reader->position = 0;
+        if (reader->end == 0)
+        {
+            return -1;
+        }
+    }
+    return reader->data[reader->position++];
+}
+
+// Function that reads a little-endian number of 'bytes' bytes. Returns 0 if the archive ends first.
+int readLittleEndian(RecordReader* reader, int bytes, uint64_t* value)
+{
+    *value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        int byte = nextRecordByte(reader);
+        if (byte < 0)
+        {
+            return 0;
+        }
+        *value |= (uint64_t)byte << (8 * i);
+    }
+    return 1;
+}
+
+// Function that describes a problem with a game of the archive, while there have been few enough.
+void reportRecordError(uint64_t* errors, uint64_t game, const RecordReader* reader, const char* message)
+{
+    if (++*errors <= RECORD_MAX_REPORTS)
+    {
+        printf("ERROR: Game %llu (byte %llu): %s. \n", (unsigned long long)game,
+            (unsigned long long)(reader->offset + reader->position), message);
+    }
+}
+
+// Function that replays every game of an archive, checks its moves and results, and prints the totals.
+// Returns 0 when every game checked out.
+int runReplay(const char* path)
+{
+    RecordReader* reader = (RecordReader*)malloc(sizeof(RecordReader));
+    if (reader == NULL)
+    {
+        printf("ERROR: Out of memory for the replay. \n");
+        return 1;
+    }
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL)
+    {
+        printf("ERROR: Could not open the game archive '%s'. \n", path);
+        free(reader);
+        return 1;
+    }
+    reader->position = 0;
+    reader->end = 0;
+    reader->offset = 0;
+
+    uint64_t magic = 0;
+    if (!readLittleEndian(reader, 4, &magic) || magic != RECORD_MAGIC || nextRecordByte(reader) != RECORD_VERSION)
+    {
+        printf("ERROR: '%s' is not a version %d game archive. \n", path, RECORD_VERSION);
+        fclose(reader->file);
+        free(reader);
+        return 1;
+    }
+
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    uint64_t errors = 0;
+    uint64_t results[3] = { 0, 0, 0 };
+    uint64_t start = nowNanoseconds();
+    int byte;
+    while ((byte = nextRecordByte(reader)) >= 0)
+    {
+        games++;
+        if (byte != RECORD_GAME_START)
+        {
+            // Without the start of a game there is no telling where the next one begins.
+            reportRecordError(&errors, games, reader, "expected the start of a game");
+            break;
+        }
+        uint64_t pieces[2];
+        uint64_t side;
+        if (!readLittleEndian(reader, 8, &pieces[X_INDEX]) || !readLittleEndian(reader, 8, &pieces[O_INDEX])
+            || !readLittleEndian(reader, 1, &side))
+        {
+            reportRecordError(&errors, games, reader, "the archive ends inside the start position");
+            break;
+        }
+        if (((pieces[X_INDEX] | pieces[O_INDEX]) & ~BOARD_MASK) || (pieces[X_INDEX] & pieces[O_INDEX]) || side > 1
+            || popCount(pieces[X_INDEX]) > MAX_PIECES || popCount(pieces[O_INDEX]) > MAX_PIECES)
+        {
+            reportRecordError(&errors, games, reader, "the start position is not a valid board");
+            break;
+        }
+        BitBoard board = { { pieces[X_INDEX], pieces[O_INDEX] } };
+        GameState state;
+        initGameState(&state, &board, (int)side);
+
+        // Every move is checked against the position it is played in.
+        int legal = 1;
+        while ((byte = nextRecordByte(reader)) >= 0 && byte != RECORD_GAME_END)
+        {
+            if (!legal)
+            {
+                // The rest of a broken game is skipped.
+                continue;
+            }
+            int index = byte >> 2;
+            Move move;
+            move.from = (uint8_t)CELL(index / SIDE, index % SIDE);
+            int to = move.from + record_steps[byte & 3];
+            move.to = (uint8_t)to;
+            if (index >= SIDE * SIDE || to < 0 || !((UINT64_C(1) << to) & emptyCells(&state.board))
+                || !(state.board.pieces[state.side] & (UINT64_C(1) << move.from)))
+            {
+                reportRecordError(&errors, games, reader, "illegal move");
+                legal = 0;
+                continue;
+            }
+            applyMove(&state, move);
+            moves++;
+        }
+        int result = (byte < 0) ? -1 : nextRecordByte(reader);
+        if (result < 0)
+        {
+            reportRecordError(&errors, games, reader, "the archive ends inside the game");
+            break;
+        }
+        if (!legal)
+        {
+            continue;
+        }
+        int stuck = (result & RECORD_STUCK) != 0;
+        int winner = result & ~RECORD_STUCK;
+        int expected = decideWinner(&state, stuck);
+        if ((stuck && !isGameOver(&state)) || winner > RECORD_DRAW || winner != ((expected == DRAW) ? RECORD_DRAW : expected))
+        {
+            reportRecordError(&errors, games, reader, "the recorded result does not follow from the moves");
+            continue;
+        }
+        results[winner]++;
+    }
+    double seconds = (nowNanoseconds() - start) / 1e9;
+    fclose(reader->file);
+    free(reader);
+
+    if (errors > RECORD_MAX_REPORTS)
+    {
+        printf("... and %llu more errors.\n", (unsigned long long)(errors - RECORD_MAX_REPORTS));
+    }
+    printf("Replayed %llu games, %llu moves in %.3f s (%.1f million moves/sec)\n", (unsigned long long)games,
+        (unsigned long long)moves, seconds, seconds > 0 ? moves / seconds / 1e6 : 0.0);
+    printf("Results: 'X' won %llu, 'O' won %llu, %llu draws; %llu games with errors\n", (unsigned long long)results[X_INDEX],
+        (unsigned long long)results[O_INDEX], (unsigned long long)results[RECORD_DRAW], (unsigned long long)errors);
+    return errors > 0;
+}
+
+/***************************************************
+ * Sessions.
+ *
+ * One game between a user and the computer: its start board, the state in play,
+ * the history of moves and the turn limit. The interactive game drives one session
+ * from the prompts; the server drives many at once from its line protocol.
+****************************************************/
+
+typedef struct Session
+{
+    BitBoard start;
+    GameState state;
+    // The moves played, for takeback and redo.
+    GameHistory history;
+    // The index of the user's player; 'X' always moves first.
+    int user;
+    // The turn limit and the moves played so far.
+    int turns;
+    int turn_count;
+    // Set when the game ended with the player to move stuck, rather than on the turn limit.
+    int game_over;
+} Session;
+
+void initSession(Session* session)
+{
+    initHistory(&session->history);
+}
+
+void freeSession(Session* session)
+{
+    freeHistory(&session->history);
+}
+
+// Function that sets up a new game in the session on a random board with 'pieces' per player.
+void startSession(Session* session, int user, int pieces, int turns, Random* rng)
+{
+    initializeBoard(&session->start, pieces, rng);
+    initGameState(&session->state, &session->start, X_INDEX);
+    session->history.count = 0;
+    session->history.length = 0;
+    session->user = user;
+    session->turns = turns;
+    session->turn_count = 0;
+    session->game_over = 0;
+}
+
+// Function that checks whether the game has ended, on the turn limit or with the player to move stuck.
+int sessionOver(Session* session)
+{
+    session->game_over = session->turn_count < session->turns && isGameOver(&session->state);
+    return session->game_over || session->turn_count >= session->turns;
+}
+
+int sessionUserToMove(const Session* session)
+{
+    return session->state.side == session->user;
+}
+
+// Function that plays a legal move of the player to move. Returns 0 if the history has no room for it.
+int sessionPlay(Session* session, Move move)
+{
+    if (!playMove(&session->state, &session->history, move))
+    {
+        return 0;
+    }
+    session->turn_count++;
+    PROFILE_TURN();
+    return 1;
+}
+
+// Function that takes back the user's last move, and the computer's reply if there was one.
+// Returns the number of moves taken back, or 0 if the user has no move to take back.
+int sessionTakeBack(Session* session)
+{
+    int plies = sessionUserToMove(session) ? 2 : 1;
+    if (session->history.count < plies)
+    {
+        return 0;
+    }
+    for (int i = 0; i < plies; i++)
+    {
+        takeBack(&session->state, &session->history);
+    }
+    session->turn_count -= plies;
+    return plies;
+}
+
+// Function that plays again the moves taken back up to the user's next turn.
+// Returns the number of moves played, or 0 if there is nothing to redo.
+int sessionRedo(Session* session)
+{
+    int plies = 0;
+    while (session->history.length > session->history.count && (plies == 0 || !sessionUserToMove(session)))
+    {
+        redoMove(&session->state, &session->history);
+        plies++;
+    }
+    session->turn_count += plies;
+    return plies;
+}
+
+// Function that appends the game of the session to an archive. The moves taken back are not part of it.
+void recordSession(GameRecorder* recorder, const Session* session)
+{
+    recordGameStart(recorder, &session->start, X_INDEX);
+    for (int i = 0; i < session->history.count; i++)
+    {
+        recordMove(recorder, session->history.records[i].move);
+    }
+    recordGameEnd(recorder, decideWinner(&session->state, session->game_over), session->game_over);
+}
+
+/***************************************************
+ * Large boards.
+ *
+ * Boards other than the 7x7 one, up to 32x32, are chosen at run time with
+ * --size. They do not fit a 64-bit bitboard, so each player's pieces are
+ * kept as one 32-bit bitset per row together with a list of the cells they
+ * stand on. A player's moves are found by walking that list, and the valid
+ * move counts are updated move by move from the cells around the move, so
+ * what a move costs depends on the pieces and not on the area of the board.
+ * The 7x7 board keeps its bitboards and everything built on them.
+****************************************************/
+
+// The largest board, the most pieces a player can have on it and the most moves they can have.
+#define WIDE_MAX_SIDE 32
+#define WIDE_MAX_PIECES ((WIDE_MAX_SIDE * WIDE_MAX_SIDE) / 2)
+#define WIDE_MAX_MOVES (4 * WIDE_MAX_PIECES)
+// Room for the name of a cell, e.g. "af31".
+#define WIDE_CELL_TEXT 8
+
+// A cell of a large board is numbered row * WIDE_MAX_SIDE + column, whatever the size of the board.
+#define WIDE_CELL(i, j) ((i) * WIDE_MAX_SIDE + (j))
+#define WIDE_ROW(cell) ((cell) / WIDE_MAX_SIDE)
+#define WIDE_COL(cell) ((cell) % WIDE_MAX_SIDE)
+
+// The four directions a piece slides in: up, down, left and right.
+const int wide_row_steps[4] = { -1, 1, 0, 0 };
+const int wide_col_steps[4] = { 0, 0, -1, 1 };
+
+typedef struct WideMove
+{
+    uint16_t from;
+    uint16_t to;
+} WideMove;
+
+typedef struct WideMoveList
+{
+    int count;
+    WideMove moves[WIDE_MAX_MOVES];
+} WideMoveList;
+
+// A position on a large board.
+typedef struct WideBoard
+{
+    // The board is 'size' cells wide and high, and 'side' is the player to move.
+    int size;
+    int side;
+    // Bit j of rows[p][i] is set when player p has a piece on row i, column j.
+    uint32_t rows[2][WIDE_MAX_SIDE];
+    // The cells of each player's pieces, and for every occupied cell its place in that list.
+    uint16_t piece_cells[2][WIDE_MAX_PIECES];
+    int piece_count[2];
+    uint16_t piece_slot[WIDE_MAX_SIDE * WIDE_MAX_SIDE];
+    // The valid moves of each player.
+    int mobility[2];
+} WideBoard;
+
+// Function that returns the occupied cells of one row.
+static inline uint32_t wideOccupied(const WideBoard* board, int row)
+{
+    return board->rows[X_INDEX][row] | board->rows[O_INDEX][row];
+}
+
+// Function that returns the player with a piece on 'cell', or -1 if it is vacant.
+int widePieceAt(const WideBoard* board, int cell)
+{
+    uint32_t bit = UINT32_C(1) << WIDE_COL(cell);
+    if (board->rows[X_INDEX][WIDE_ROW(cell)] & bit)
+    {
+        return X_INDEX;
+    }
+    if (board->rows[O_INDEX][WIDE_ROW(cell)] & bit)
+    {
+        return O_INDEX;
+    }
+    return -1;
+}
+
+// Function that returns the directions in which the cell next to 'cell' is on the board and vacant,
+// bit d standing for direction d.
+int wideFreeSides(const WideBoard* board, int cell)
+{
+    int i = WIDE_ROW(cell);
+    int j = WIDE_COL(cell);
+    uint32_t row = wideOccupied(board, i);
+    int sides = 0;
+    if (i > 0 && !((wideOccupied(board, i - 1) >> j) & 1))
+    {
+        sides |= 1;
+    }
+    if (i + 1 < board->size && !((wideOccupied(board, i + 1) >> j) & 1))
+    {
+        sides |= 2;
+    }
+    if (j > 0 && !((row >> (j - 1)) & 1))
+    {
+        sides |= 4;
+    }
+    if (j + 1 < board->size && !((row >> (j + 1)) & 1))
+    {
+        sides |= 8;
+    }
+    return sides;
+}
+
+// Function that returns the cell one step from 'cell' in direction 'd'.
+static inline int wideStep(int cell, int d)
+{
+    return cell + wide_row_steps[d] * WIDE_MAX_SIDE + wide_col_steps[d];
+}
+
+// Function that adds 'delta' to the valid move count of the owner of every piece next to 'cell',
+// leaving out the piece on 'skip'.
+void wideAdjustNeighbours(WideBoard* board, int cell, int skip, int delta)
+{
+    int i = WIDE_ROW(cell);
+    int j = WIDE_COL(cell);
+    for (int d = 0; d < 4; d++)
+    {
+        int ni = i + wide_row_steps[d];
+        int nj = j + wide_col_steps[d];
+        if (ni < 0 || ni >= board->size || nj < 0 || nj >= board->size || WIDE_CELL(ni, nj) == skip)
+        {
+            continue;
+        }
+        int owner = widePieceAt(board, WIDE_CELL(ni, nj));
+        if (owner >= 0)
+        {
+            board->mobility[owner] += delta;
+        }
+    }
+}
+
+// Function that slides the piece on 'from' to the vacant neighbouring cell 'to'. The valid move counts
+// change only for the moved piece and for the pieces next to the two cells.
+void wideSlide(WideBoard* board, int from, int to)
+{
+    int player = widePieceAt(board, from);
+    board->mobility[player] -= popCount(wideFreeSides(board, from));
+    // The pieces next to 'to' can no longer move there.
+    wideAdjustNeighbours(board, to, from, -1);
+    board->rows[player][WIDE_ROW(from)] ^= UINT32_C(1) << WIDE_COL(from);
+    board->rows[player][WIDE_ROW(to)] ^= UINT32_C(1) << WIDE_COL(to);
+    int slot = board->piece_slot[from];
+    board->piece_cells[player][slot] = (uint16_t)to;
+    board->piece_slot[to] = (uint16_t)slot;
+    // The pieces next to 'from' can move there now.
+    wideAdjustNeighbours(board, from, to, 1);
+    board->mobility[player] += popCount(wideFreeSides(board, to));
+}
+
+// Function that plays a move of the player to move. It is taken back by wideUnmakeMove().
+void wideMakeMove(WideBoard* board, WideMove move)
+{
+    wideSlide(board, move.from, move.to);
+    board->side = !board->side;
+}
+
+// Function that takes back a move: a slide is undone by the slide the other way.
+void wideUnmakeMove(WideBoard* board, WideMove move)
+{
+    board->side = !board->side;
+    wideSlide(board, move.to, move.from);
+}
+
+// Function that sets up a board 'size' cells wide with 'player_pieces' pieces per player on random
+// cells, with 'X' to move. The cells are drawn as initializeBoard() draws them.
+void initWideBoard(WideBoard* board, int size, int player_pieces, Random* rng)
+{
+    // The cells not drawn yet are cells[drawn..size * size).
+    uint16_t cells[WIDE_MAX_SIDE * WIDE_MAX_SIDE];
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            cells[i * size + j] = (uint16_t)WIDE_CELL(i, j);
+        }
+    }
+    memset(board, 0, sizeof(WideBoard));
+    board->size = size;
+    board->side = X_INDEX;
+    for (int drawn = 0; drawn < 2 * player_pieces; drawn++)
+    {
+        int pick = drawn + randomBelow(rng, size * size - drawn);
+        uint16_t cell = cells[pick];
+        cells[pick] = cells[drawn];
+        cells[drawn] = cell;
+        int player = (drawn < player_pieces) ? X_INDEX : O_INDEX;
+        board->rows[player][WIDE_ROW(cell)] |= UINT32_C(1) << WIDE_COL(cell);
+        board->piece_slot[cell] = (uint16_t)board->piece_count[player];
+        board->piece_cells[player][board->piece_count[player]++] = cell;
+    }
+    // The only full count; moves update it from here on.
+    for (int p = 0; p < 2; p++)
+    {
+        for (int k = 0; k < board->piece_count[p]; k++)
+        {
+            board->mobility[p] += popCount(wideFreeSides(board, board->piece_cells[p][k]));
+        }
+    }
+}
+
+// Function that fills 'list' with every valid move of a player, piece by piece.
+void generateWideMoves(const WideBoard* board, int player, WideMoveList* list)
+{
+    list->count = 0;
+    for (int k = 0; k < board->piece_count[player]; k++)
+    {
+        int cell = board->piece_cells[player][k];
+        for (int sides = wideFreeSides(board, cell); sides; sides &= sides - 1)
+        {
+            list->moves[list->count].from = (uint16_t)cell;
+            list->moves[list->count].to = (uint16_t)wideStep(cell, lowestBit(sides));
+            list->count++;
+        }
+    }
+}
+
+// Function that writes the name of a row into 'out': 'a' to 'z', then 'aa', 'ab' and so on.
+int wideRowName(int row, char* out)
+{
+    int n = 0;
+    if (row >= 26)
+    {
+        out[n++] = (char)('a' + row / 26 - 1);
+    }
+    out[n++] = (char)('a' + row % 26);
+    out[n] = 0;
+    return n;
+}
+
+// Function that writes the name of a cell into 'out' (WIDE_CELL_TEXT bytes): its row letters and then
+// its column number, e.g. "ab17". Up to 26 rows and 10 columns this is the 7x7 board's notation.
+void wideCellToString(int cell, char* out)
+{
+    int n = wideRowName(WIDE_ROW(cell), out);
+    snprintf(out + n, WIDE_CELL_TEXT - n, "%d", WIDE_COL(cell));
+}
+
+// Function that reads the name of a cell of a board 'size' cells wide.
+// Returns -1 if it is not a name or the cell lies outside the board.
+int wideCellFromString(const char* text, int size)
+{
+    int row = 0;
+    int letters = 0;
+    while (isalpha((unsigned char)text[letters]))
+    {
+        if (letters == 2)
+        {
+            return -1;
+        }
+        row = row * 26 + tolower((unsigned char)text[letters]) - 'a' + 1;
+        letters++;
+    }
+    int col = 0;
+    int digits = 0;
+    while (isdigit((unsigned char)text[letters + digits]))
+    {
+        if (digits == 2)
+        {
+            return -1;
+        }
+        col = col * 10 + text[letters + digits] - '0';
+        digits++;
+    }
+    row--;
+    if (letters == 0 || digits == 0 || text[letters + digits] != 0 || row >= size || col >= size)
+    {
+        return -1;
+    }
+    return WIDE_CELL(row, col);
+}
+
+// Function that renders a large board into the buffer, laid out like renderBoard() does the 7x7 one.
+void renderWideBoard(RenderBuffer* out, const WideBoard* board)
+{
+    char line[3 * WIDE_MAX_SIDE + 8];
+    int n = snprintf(line, sizeof(line), "  ");
+    for (int j = 0; j < board->size; j++)
+    {
+        n += snprintf(line + n, sizeof(line) - n, "%2d ", j);
+    }
+    renderf(out, "%s\n", line);
+
+    for (int i = 0; i < board->size; i++)
+    {
+        char name[WIDE_CELL_TEXT];
+        wideRowName(i, name);
+        n = snprintf(line, sizeof(line), "%-2s", name);
+        for (int j = 0; j < board->size; j++)
+        {
+            int owner = widePieceAt(board, WIDE_CELL(i, j));
+            line[n++] = ' ';
+            line[n++] = (owner == X_INDEX) ? PLAYER_ONE : (owner == O_INDEX) ? PLAYER_TWO : ' ';
+            line[n++] = ' ';
+        }
+        line[n] = 0;
+        renderf(out, "%s\n", line);
+    }
+}
+
+// Function that picks a random move of the piece with the most moves, as chooseGreedyMove() does.
+WideMove chooseWideGreedyMove(const WideBoard* board, Random* rng)
+{
+    int player = board->side;
+    int max_cell = board->piece_cells[player][0];
+    int max = 0;
+    for (int k = 0; k < board->piece_count[player]; k++)
+    {
+        int cell = board->piece_cells[player][k];
+        int count = popCount(wideFreeSides(board, cell));
+        if (count > max)
+        {
+            max = count;
+            max_cell = cell;
+        }
+    }
+    int sides = wideFreeSides(board, max_cell);
+    for (int pick = randomBelow(rng, popCount(sides)); pick > 0; pick--)
+    {
+        sides &= sides - 1;
+    }
+    WideMove move = { (uint16_t)max_cell, (uint16_t)wideStep(max_cell, lowestBit(sides)) };
+    return move;
+}
+
+// What a search on a large board keeps track of.
+typedef struct WideSearch
+{
+    uint64_t nodes;
+    // Timestamp at which the search must stop, or 0 for no time limit.
+    uint64_t deadline;
+    int stopped;
+    // The move tried first at the root, and the best root move of the iteration in progress.
+    WideMove first;
+    WideMove best;
+} WideSearch;
+
+// Function that searches a large board by negamax with alpha-beta pruning, as negamax() does the 7x7 one.
+int wideNegamax(WideSearch* search, WideBoard* board, int depth, int alpha, int beta, int ply)
+{
+    search->nodes++;
+    if ((search->nodes % CLOCK_CHECK_NODES) == 0 && search->deadline && nowNanoseconds() >= search->deadline)
+    {
+        search->stopped = 1;
+    }
+    if (search->stopped)
+    {
+        return 0;
+    }
+    if (board->mobility[board->side] == 0)
+    {
+        // No legal slide: the player to move has lost.
+        return -WIN_SCORE + ply;
+    }
+    if (depth == 0)
+    {
+        return board->mobility[board->side] - board->mobility[!board->side];
+    }
+
+    WideMoveList list;
+    generateWideMoves(board, board->side, &list);
+    if (ply == 0)
+    {
+        // The best move of the last iteration is tried first.
+        for (int i = 0; i < list.count; i++)
+        {
+            if (list.moves[i].from == search->first.from && list.moves[i].to == search->first.to)
+            {
+                list.moves[i] = list.moves[0];
+                list.moves[0] = search->first;
+                break;
+            }
+        }
+    }
+    int best = -WIN_SCORE - 1;
+    for (int i = 0; i < list.count; i++)
+    {
+        wideMakeMove(board, list.moves[i]);
+        int score = -wideNegamax(search, board, depth - 1, -beta, -alpha, ply + 1);
+        wideUnmakeMove(board, list.moves[i]);
+        if (search->stopped)
+        {
+            return 0;
+        }
+        if (score > best)
+        {
+            best = score;
+            if (ply == 0)
+            {
+                search->best = list.moves[i];
+            }
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+        }
+        if (alpha >= beta)
+        {
+            break;
+        }
+    }
+    return best;
+}
+
+// Function that chooses the computer's move on a large board and fills in 'result' as selectMove() does.
+// The alpha-beta engine deepens one ply at a time to its depth or until its time runs out. It has no
+// transposition table or tablebase, which are built on the 7x7 bitboards; the greedy engine plays as ever.
+// The caller guarantees that the player to move has at least one move.
+WideMove chooseWideMove(WideBoard* board, const EngineConfig* engine, Random* rng, SearchResult* result)
+{
+    uint64_t start = nowNanoseconds();
+    memset(result, 0, sizeof(SearchResult));
+    result->threads = 1;
+    if (engine->kind != ENGINE_ALPHABETA)
+    {
+        WideMove move = chooseWideGreedyMove(board, rng);
+        result->nanoseconds = nowNanoseconds() - start;
+        return move;
+    }
+    WideSearch search;
+    memset(&search, 0, sizeof(search));
+    search.deadline = (engine->movetime_ms > 0) ? start + (uint64_t)engine->movetime_ms * 1000000u : 0;
+    // Until depth 1 completes, any legal move is the answer.
+    WideMoveList list;
+    generateWideMoves(board, board->side, &list);
+    WideMove best = list.moves[0];
+    for (int depth = 1; depth <= engine->depth; depth++)
+    {
+        search.first = best;
+        int score = wideNegamax(&search, board, depth, -WIN_SCORE - 1, WIN_SCORE + 1, 0);
+        if (search.stopped)
+        {
+            break;
+        }
+        best = search.best;
+        result->score = score;
+        result->depth = depth;
+        result->depth_nanoseconds[depth] = nowNanoseconds() - start;
+        if (score >= WIN_BOUND || score <= -WIN_BOUND)
+        {
+            // The game is decided within the horizon; a deeper search finds nothing new.
+            break;
+        }
+    }
+    result->nodes = search.nodes;
+    result->nanoseconds = nowNanoseconds() - start;
+    return best;
+}
+
+// Function that decides the winner of a game on a large board, as decideWinner() does.
+int decideWideWinner(const WideBoard* board, int game_over)
+{
+    if (game_over)
+    {
+        return !board->side;
+    }
+    if (board->mobility[X_INDEX] == board->mobility[O_INDEX])
+    {
+        return DRAW;
+    }
+    return (board->mobility[X_INDEX] > board->mobility[O_INDEX]) ? X_INDEX : O_INDEX;
+}
+
+/***************************************************
+ * Self-play.
+ *
+ * Computer-against-computer games with no prompts and no per-turn output,
+ * for evaluating engine settings over large batches.
+****************************************************/
+
+typedef struct GameOutcome
+{
+    int winner;
+    // Turns played before the game ended.
+    int turns_played;
+    // Set when the game ended because the player to move was stuck, rather than on the turn limit.
+    int no_moves;
+    // Moves made by each player, and the time spent choosing them.
+    int moves[2];
+    uint64_t think_nanoseconds[2];
+} GameOutcome;
+
+// Function that plays one game between two engines from the given start board, without printing anything.
+// The game is appended to 'recorder' unless it is NULL.
+void playGame(const BitBoard* start, int turns, const EngineConfig engines[2], TranspositionTable tts[2], Random* rng,
+    GameRecorder* recorder, GameOutcome* outcome)
+{
+    GameState state;
+    initGameState(&state, start, X_INDEX);
+    if (recorder)
+    {
+        recordGameStart(recorder, start, X_INDEX);
+    }
+    int turn_count = 0;
+    int game_over = 0;
+    memset(outcome->moves, 0, sizeof(outcome->moves));
+    memset(outcome->think_nanoseconds, 0, sizeof(outcome->think_nanoseconds));
+    while (turn_count < turns)
+    {
+        game_over = isGameOver(&state);
+        if (game_over)
+        {
+            break;
+        }
+        SearchResult result;
+        uint64_t start = nowNanoseconds();
+        Move move = selectMove(&tts[state.side], &state, &engines[state.side], turns - turn_count, rng, &result);
+        outcome->think_nanoseconds[state.side] += nowNanoseconds() - start;
+        outcome->moves[state.side]++;
+        if (recorder)
+        {
+            recordMove(recorder, move);
+        }
+        applyMove(&state, move);
+        turn_count++;
+        PROFILE_TURN();
+    }
+    outcome->winner = decideWinner(&state, game_over);
+    if (recorder)
+    {
+        recordGameEnd(recorder, outcome->winner, game_over);
+    }
+    outcome->turns_played = turn_count;
+    outcome->no_moves = game_over;
+}
+
+// Function that plays one game between two engines on a large board, as playGame() does on the 7x7 one.
+void playWideGame(WideBoard* board, int turns, const EngineConfig engines[2], Random* rng, GameOutcome* outcome)
+{
+    int turn_count = 0;
+    int game_over = 0;
+    memset(outcome->moves, 0, sizeof(outcome->moves));
+    memset(outcome->think_nanoseconds, 0, sizeof(outcome->think_nanoseconds));
+    while (turn_count < turns)
+    {
+        game_over = board->mobility[board->side] == 0;
+        if (game_over)
+        {
+            break;
+        }
+        SearchResult result;
+        int side = board->side;
+        WideMove move = chooseWideMove(board, &engines[side], rng, &result);
+        outcome->think_nanoseconds[side] += result.nanoseconds;
+        outcome->moves[side]++;
+        wideMakeMove(board, move);
+        turn_count++;
+        PROFILE_TURN();
+    }
+    outcome->winner = decideWideWinner(board, game_over);
+    outcome->turns_played = turn_count;
+    outcome->no_moves = game_over;
+}
+
+// Function that describes an engine in one line, e.g. "alphabeta depth 6".
+void describeEngine(const EngineConfig* engine, char* out, size_t size)
+{
+    if (engine->kind == ENGINE_GREEDY)
+    {
+        snprintf(out, size, "greedy");
+    }
+    else if (engine->kind == ENGINE_MCTS && engine->movetime_ms > 0)
+    {
+        snprintf(out, size, "mcts %d ms/move, %d nodes", engine->movetime_ms, engine->mcts_nodes);
+    }
+    else if (engine->kind == ENGINE_MCTS)
+    {
+        snprintf(out, size, "mcts %d playouts/move, %d nodes", engine->playouts, engine->mcts_nodes);
+    }
+    else if (engine->movetime_ms > 0)
+    {
+        snprintf(out, size, "alphabeta %d ms/move, %d thread(s)", engine->movetime_ms, engine->threads);
+    }
+    else {
+        snprintf(out, size, "alphabeta depth %d, %d thread(s)", engine->depth, engine->threads);
+    }
+}
+
+// Function that plays the self-play batch and prints the aggregate results.
+int runSelfPlay(const Options* options)
+{
+    TranspositionTable tts[2] = { { NULL, 0, 0 }, { NULL, 0, 0 } };
+    for (int p = 0; p < 2; p++)
+    {
+        // Large boards are searched without a table.
+        if (options->engines[p].kind == ENGINE_ALPHABETA && options->size == SIDE
+            && !ttInit(&tts[p], options->engines[p].hash_mb))
+        {
+            printf("ERROR: Could not allocate a %d MB transposition table. \n", options->engines[p].hash_mb);
+            ttFree(&tts[0]);
+            return 1;
+        }
+    }
+    GameRecorder recorder;
+    if (options->record != NULL && !openRecorder(&recorder, options->record))
+    {
+        printf("ERROR: Could not open the game archive '%s'. \n", options->record);
+        ttFree(&tts[X_INDEX]);
+        ttFree(&tts[O_INDEX]);
+        return 1;
+    }
+
+    char names[2][128];
+    describeEngine(&options->engines[X_INDEX], names[X_INDEX], sizeof(names[X_INDEX]));
+    describeEngine(&options->engines[O_INDEX], names[O_INDEX], sizeof(names[O_INDEX]));
+    printf("Self-play: %ld games, %d pieces per player, %d turns, seed %llu\n", options->games, options->pieces,
+        options->turns, (unsigned long long)options->seed);
+    if (options->size != SIDE)
+    {
+        printf("Board: %dx%d\n", options->size, options->size);
+    }
+    printf("Player 'X': %s\nPlayer 'O': %s\n", names[X_INDEX], names[O_INDEX]);
+
+    long wins[2] = { 0, 0 };
+    long draws = 0;
+    long stuck = 0;
+    long total_turns = 0;
+    Random rng;
+    seedRandom(&rng, options->seed);
+    uint64_t start = nowNanoseconds();
+    for (long g = 0; g < options->games; g++)
+    {
+        GameOutcome outcome;
+        if (options->size != SIDE)
+        {
+            WideBoard board;
+            initWideBoard(&board, options->size, options->pieces, &rng);
+            playWideGame(&board, options->turns, options->engines, &rng, &outcome);
+        }
+        else {
+            BitBoard board;
+            initializeBoard(&board, options->pieces, &rng);
+            playGame(&board, options->turns, options->engines, tts, &rng, options->record ? &recorder : NULL, &outcome);
+        }
+        if (outcome.winner == DRAW)
+        {
+            draws++;
+        }
+        else {
+            wins[outcome.winner]++;
+        }
+        stuck += outcome.no_moves;
+        total_turns += outcome.turns_played;
+    }
+    double seconds = (nowNanoseconds() - start) / 1e9;
+
+    printf("\nResults for 'X': %ld wins, %ld draws, %ld losses\n", wins[X_INDEX], draws, wins[O_INDEX]);
+    printf("Games ended with a player out of moves: %ld, on the turn limit: %ld\n", stuck, options->games - stuck);
+    printf("Average game length: %.2f turns\n", (double)total_turns / options->games);
+    printf("Played %ld games in %.3f s (%.1f games/sec)\n", options->games, seconds,
+        seconds > 0 ? options->games / seconds : 0.0);
+
+    int status = 0;
+    if (options->record != NULL && !closeRecorder(&recorder))
+    {
+        printf("ERROR: Could not write the game archive '%s'. \n", options->record);
+        status = 1;
+    }
+    ttFree(&tts[X_INDEX]);
+    ttFree(&tts[O_INDEX]);
+    return status;
+}
+
+// Seeded positions searched by the speedup test, and pieces per player on each.
+#define SPEEDUP_POSITIONS 8
+#define SPEEDUP_PIECES 12
+
+/*
+ * Function that measures what the extra threads buy at equal time.
+ * Every position is searched for the same time with one thread and with the configured number
+ * of threads. The speedup of a position is how much sooner the threads completed the deepest
+ * iteration that the single thread completed.
+*/
+void runSpeedupTest(const EngineConfig* engine)
+{
+    int movetime_ms = (engine->movetime_ms > 0) ? engine->movetime_ms : 1000;
+    TranspositionTable tt;
+    if (!ttInit(&tt, engine->hash_mb))
+    {
+        printf("ERROR: Could not allocate a %d MB transposition table. \n", engine->hash_mb);
+        return;
+    }
+
+    printf("Parallel search speedup: %d thread(s) against 1, %d ms per position\n\n", engine->threads, movetime_ms);
+    printf("%-9s %-8s %-8s %-14s %-14s %s\n", "position", "depth 1", "depth N", "nodes/sec 1", "nodes/sec N", "time-to-depth speedup");
+    double log_speedup = 0;
+    int measured = 0;
+    double nps_single = 0;
+    double nps_multi = 0;
+    int depth_single = 0;
+    int depth_multi = 0;
+    SearchResult single;
+    SearchResult multi;
+    for (int i = 0; i < SPEEDUP_POSITIONS; i++)
+    {
+        // Fixed seeds give the same positions on every run.
+        BitBoard board;
+        GameState state;
+        Random rng;
+        seedRandom(&rng, i + 1);
+        initializeBoard(&board, SPEEDUP_PIECES, &rng);
+        initGameState(&state, &board, X_INDEX);
+
+        // Both runs start from an empty table.
+        ttClear(&tt);
+        searchBestMove(&tt, &state, MAX_DEPTH, movetime_ms, 1, 0, &single);
+        ttClear(&tt);
+        searchBestMove(&tt, &state, MAX_DEPTH, movetime_ms, engine->threads, 0, &multi);
+
+        double rate_single = single.nodes / (single.nanoseconds / 1e9);
+        double rate_multi = multi.nodes / (multi.nanoseconds / 1e9);
+        nps_single += rate_single;
+        nps_multi += rate_multi;
+        depth_single += single.depth;
+        depth_multi += multi.depth;
+        printf("%-9d %-8d %-8d %-14.0f %-14.0f ", i + 1, single.depth, multi.depth, rate_single, rate_multi);
+        uint64_t reached = (single.depth > 0) ? multi.depth_nanoseconds[single.depth] : 0;
+        if (reached)
+        {
+            double speedup = (double)single.depth_nanoseconds[single.depth] / (double)reached;
+            log_speedup += log(speedup);
+            measured++;
+            printf("%.2fx\n", speedup);
+        }
+        else {
+            printf("-\n");
+        }
+    }
+
+    printf("\nAverage depth: %.2f with 1 thread, %.2f with %d\n", (double)depth_single / SPEEDUP_POSITIONS,
+        (double)depth_multi / SPEEDUP_POSITIONS, engine->threads);
+    printf("Node rate: %.2fx\n", nps_multi / nps_single);
+    if (measured > 0)
+    {
+        printf("Time-to-depth speedup (geometric mean of %d positions): %.2fx\n", measured, exp(log_speedup / measured));
+    }
+    ttFree(&tt);
+}
+
+/***************************************************
+ * Tournament.
+ *
+ * Two or more engine configurations play each other on seeded openings, spread
+ * over a pool of worker threads. Every opening is played twice by each pair
+ * of entrants, with the colours swapped, so neither side gains from a lucky
+ * board. A pair of games is the unit of work and of the statistics: the five
+ * possible pair scores (0, 0.5, 1, 1.5 or 2 points) give the error bars and
+ * the sequential probability ratio test.
+****************************************************/
+
+#define TOURNAMENT_MAX_PAIRINGS (TOURNAMENT_MAX_ENTRANTS * (TOURNAMENT_MAX_ENTRANTS - 1) / 2)
+// The 95% quantile of the normal distribution, for the error bars.
+#define ELO_ERROR_QUANTILE 1.959964
+// The error rates of the sequential test, of accepting H1 when H0 holds and H0 when H1 holds.
+#define SPRT_ALPHA 0.05
+#define SPRT_BETA 0.05
+// The weight of a pseudo-opening spread evenly over the five pair scores, which keeps the variance
+// above zero when every opening so far scored the same.
+#define PENTANOMIAL_PRIOR 1.0
+
+// The results of one pairing, from the point of view of its first entrant.
+typedef struct PairingResult
+{
+    int first;
+    int second;
+    long wins;
+    long draws;
+    long losses;
+    // Openings by the points the first entrant scored over both games, in half points from 0 to 4.
+    long pairs[5];
+} PairingResult;
+
+typedef struct Tournament
+{
+    const Options* options;
+    int pairings;
+    // The next game pair to hand out; a pair is an opening index times the pairings plus the pairing.
+    atomic_long next_pair;
+    long total_pairs;
+    // Raised when the sequential test has decided.
+    atomic_int stop;
+    pthread_mutex_t lock;
+    // Everything below is guarded by the lock.
+    PairingResult results[TOURNAMENT_MAX_PAIRINGS];
+    uint64_t think_nanoseconds[TOURNAMENT_MAX_ENTRANTS];
+    uint64_t moves[TOURNAMENT_MAX_ENTRANTS];
+    long games;
+    // The log-likelihood ratio when the test decided, and the hypothesis it accepted (0 or 1), or -1.
+    double llr;
+    int accepted;
+} Tournament;
+
+typedef struct TournamentWorker
+{
+    pthread_t thread;
+    Tournament* tournament;
+    // Every entrant has a table of its own in every worker.
+    TranspositionTable tts[TOURNAMENT_MAX_ENTRANTS];
+} TournamentWorker;
+
+// Function that returns the expected score of a player rated 'elo' points above its opponent.
+double scoreFromElo(double elo)
+{
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+// Function that returns the rating difference that an expected score stands for.
+double eloFromScore(double score)
+{
+    // A clean sweep has no finite difference; the score is kept just inside.
+    score = fmin(fmax(score, 1e-6), 1.0 - 1e-6);
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+// Function that returns the mean and the variance of the per-opening score of a pairing, as fractions of the two games.
+// The variance counts the pseudo-opening of PENTANOMIAL_PRIOR as well, so a clean sweep still has an error bar.
+long pairingStatistics(const PairingResult* r, double* mean, double* variance)
+{
+    long count = 0;
+    double sum = 0.0;
+    for (int k = 0; k < 5; k++)
+    {
+        count += r->pairs[k];
+        sum += r->pairs[k] * (k / 4.0);
+    }
+    *mean = (count > 0) ? sum / count : 0.5;
+    *variance = 0.0;
+    for (int k = 0; k < 5; k++)
+    {
+        *variance += (r->pairs[k] + PENTANOMIAL_PRIOR / 5.0) * (k / 4.0 - *mean) * (k / 4.0 - *mean);
+    }
+    *variance /= count + PENTANOMIAL_PRIOR;
+    return count;
+}
+
+// Function that returns the log-likelihood ratio of the hypotheses elo1 against elo0 for a pairing
+// (the normal approximation of the generalized SPRT).
+double sprtLlr(const PairingResult* r, double elo0, double elo1)
+{
+    double mean;
+    double variance;
+    long count = pairingStatistics(r, &mean, &variance);
+    if (count < 2)
+    {
+        return 0.0;
+    }
+    double s0 = scoreFromElo(elo0);
+    double s1 = scoreFromElo(elo1);
+    return count * (s1 - s0) * (2.0 * mean - s0 - s1) / (2.0 * variance);
+}
+
+// Function that builds the start board of an opening; the same opening always gets the same board.
+void openingBoard(const Options* options, long opening, BitBoard* board)
+{
+    Random rng;
+    seedRandom(&rng, options->seed + (uint64_t)opening);
+    initializeBoard(board, options->pieces, &rng);
+}
+
+// The body of a worker: it plays game pairs until they run out or the sequential test decides.
+void* runTournamentWorker(void* arg)
+{
+    TournamentWorker* worker = (TournamentWorker*)arg;
+    Tournament* t = worker->tournament;
+    const Options* options = t->options;
+    long index;
+    while (!atomic_load(&t->stop) && (index = atomic_fetch_add(&t->next_pair, 1)) < t->total_pairs)
+    {
+        long opening = index / t->pairings;
+        PairingResult* result = &t->results[index % t->pairings];
+        int entrants[2] = { result->first, result->second };
+        BitBoard board;
+        openingBoard(options, opening, &board);
+
+        GameOutcome outcomes[2];
+        for (int swap = 0; swap < 2; swap++)
+        {
+            // In the first game the pairing's first entrant plays 'X', in the second 'O'.
+            int x = entrants[swap];
+            int o = entrants[!swap];
+            EngineConfig engines[2] = { options->entrants[x], options->entrants[o] };
+            TranspositionTable tts[2] = { worker->tts[x], worker->tts[o] };
+            Random rng;
+            seedRandom(&rng, options->seed ^ ((uint64_t)index << 1 | swap));
+            playGame(&board, options->turns, engines, tts, &rng, NULL, &outcomes[swap]);
+            // The tables keep their replacement age from game to game.
+            worker->tts[x] = tts[0];
+            worker->tts[o] = tts[1];
+        }
+
+        pthread_mutex_lock(&t->lock);
+        int points = 0;
+        for (int swap = 0; swap < 2; swap++)
+        {
+            // The first entrant of the pairing is 'X' in the first game and 'O' in the second.
+            int side = swap ? O_INDEX : X_INDEX;
+            const GameOutcome* outcome = &outcomes[swap];
+            if (outcome->winner == DRAW)
+            {
+                result->draws++;
+                points += 1;
+            }
+            else if (outcome->winner == side)
+            {
+                result->wins++;
+                points += 2;
+            }
+            else {
+                result->losses++;
+            }
+            for (int p = 0; p < 2; p++)
+            {
+                int entrant = (p == side) ? entrants[0] : entrants[1];
+                t->think_nanoseconds[entrant] += outcome->think_nanoseconds[p];
+                t->moves[entrant] += outcome->moves[p];
+            }
+        }
+        result->pairs[points]++;
+        t->games += 2;
+        if (options->sprt && t->accepted < 0)
+        {
+            double llr = sprtLlr(result, options->sprt_elo[0], options->sprt_elo[1]);
+            double lower = log(SPRT_BETA / (1.0 - SPRT_ALPHA));
+            double upper = log((1.0 - SPRT_BETA) / SPRT_ALPHA);
+            if (llr <= lower || llr >= upper)
+            {
+                t->llr = llr;
+                t->accepted = (llr >= upper);
+                atomic_store(&t->stop, 1);
+            }
+        }
+        pthread_mutex_unlock(&t->lock);
+    }
+    return NULL;
+}
+
+// Function that plays the tournament and prints the results of every pairing and every entrant.
+int runTournament(const Options* options)
+{
+    Tournament* t = (Tournament*)calloc(1, sizeof(Tournament));
+    TournamentWorker* workers = (TournamentWorker*)calloc(options->jobs, sizeof(TournamentWorker));
+    if (t == NULL || workers == NULL)
+    {
+        printf("ERROR: Out of memory for the tournament. \n");
+        free(t);
+        free(workers);
+        return 1;
+    }
+    t->options = options;
+    for (int a = 0; a < options->entrant_count; a++)
+    {
+        for (int b = a + 1; b < options->entrant_count; b++)
+        {
+            t->results[t->pairings].first = a;
+            t->results[t->pairings].second = b;
+            t->pairings++;
+        }
+    }
+    t->total_pairs = options->openings * t->pairings;
+    atomic_init(&t->next_pair, 0);
+    atomic_init(&t->stop, 0);
+    pthread_mutex_init(&t->lock, NULL);
+    t->accepted = -1;
+
+    printf("Tournament: %d entrants, %ld openings, %ld games, %d pieces per player, %d turns, seed %llu, %d job(s)\n",
+        options->entrant_count, options->openings, 2 * t->total_pairs, options->pieces, options->turns,
+        (unsigned long long)options->seed, options->jobs);
+    for (int e = 0; e < options->entrant_count; e++)
+    {
+        char name[128];
+        describeEngine(&options->entrants[e], name, sizeof(name));
+        printf("  %d: %s\n", e + 1, name);
+    }
+
+    int status = 0;
+    int started = 0;
+    uint64_t start = nowNanoseconds();
+    for (int w = 0; w < options->jobs; w++)
+    {
+        workers[w].tournament = t;
+        int ready = 1;
+        for (int e = 0; ready && e < options->entrant_count; e++)
+        {
+            if (options->entrants[e].kind == ENGINE_ALPHABETA && !ttInit(&workers[w].tts[e], options->entrants[e].hash_mb))
+            {
+                printf("ERROR: Could not allocate a %d MB transposition table. \n", options->entrants[e].hash_mb);
+                ready = 0;
+            }
+        }
+        if (ready && pthread_create(&workers[w].thread, NULL, runTournamentWorker, &workers[w]) == 0)
+        {
+            started++;
+            continue;
+        }
+        for (int e = 0; e < options->entrant_count; e++)
+        {
+            ttFree(&workers[w].tts[e]);
+        }
+        // The workers already running play on their own.
+        status = 1;
+        break;
+    }
+    for (int w = 0; w < started; w++)
+    {
+        pthread_join(workers[w].thread, NULL);
+        for (int e = 0; e < options->entrant_count; e++)
+        {
+            ttFree(&workers[w].tts[e]);
+        }
+    }
+    double seconds = (nowNanoseconds() - start) / 1e9;
+
+    printf("\n");
+    for (int i = 0; i < t->pairings; i++)
+    {
+        const PairingResult* r = &t->results[i];
+        double mean;
+        double variance;
+        long count = pairingStatistics(r, &mean, &variance);
+        // The error of the mean of the openings, carried through the rating curve.
+        double margin = (count > 1) ? ELO_ERROR_QUANTILE * sqrt(variance / count) : 0.5;
+        double elo = eloFromScore(mean);
+        double low = eloFromScore(mean - margin);
+        double high = eloFromScore(mean + margin);
+        printf("%d vs %d: +%ld =%ld -%ld, score %.1f%%, Elo %+.1f +/- %.1f (openings scoring 0/0.5/1/1.5/2: %ld/%ld/%ld/%ld/%ld)\n",
+            r->first + 1, r->second + 1, r->wins, r->draws, r->losses, 100.0 * mean, elo, (high - low) / 2.0, r->pairs[0],
+            r->pairs[1], r->pairs[2], r->pairs[3], r->pairs[4]);
+    }
+    if (options->sprt)
+    {
+        double lower = log(SPRT_BETA / (1.0 - SPRT_ALPHA));
+        double upper = log((1.0 - SPRT_BETA) / SPRT_ALPHA);
+        double llr = (t->accepted >= 0) ? t->llr : sprtLlr(&t->results[0], options->sprt_elo[0], options->sprt_elo[1]);
+        printf("SPRT Elo %.1f vs %.1f: LLR %.2f [%.2f, %.2f], %s\n", options->sprt_elo[0], options->sprt_elo[1], llr, lower,
+            upper, (t->accepted == 1) ? "H1 accepted, stopped early" : (t->accepted == 0) ? "H0 accepted, stopped early"
+            : "no decision");
+    }
+    for (int e = 0; e < options->entrant_count; e++)
+    {
+        printf("Entrant %d: %llu moves, %.3f ms per move\n", e + 1, (unsigned long long)t->moves[e],
+            t->moves[e] ? t->think_nanoseconds[e] / 1e6 / t->moves[e] : 0.0);
+    }
+    printf("Played %ld games in %.3f s (%.1f games/sec)\n", t->games, seconds, seconds > 0 ? t->games / seconds : 0.0);
+
+    pthread_mutex_destroy(&t->lock);
+    free(workers);
+    free(t);
+    return status;
+}
+
+/***************************************************
+ * Batch analysis.
+ *
+ * Positions are read one per line from a file or stdin, searched by a pool of
+ * worker threads, and answered with one line each in the order they came in.
+ * Only a fixed window of positions is in flight at any time, so memory stays the
+ * same however long the input is.
+****************************************************/
+
+// Positions in flight per worker; the reader waits while the window is full.
+#define ANALYSIS_WINDOW_PER_JOB 16
+// Room for one line of results.
+#define ANALYSIS_LINE_SIZE 256
+
+typedef struct AnalysisSlot
+{
+    GameState state;
+    // Set once 'output' holds the finished line. A line that is not a position is finished when read.
+    int done;
+    char output[ANALYSIS_LINE_SIZE];
+} AnalysisSlot;
+
+// The window of positions shared by the reader and the workers. Position n of the input lives in
+// slots[n % window]; a slot is reused only after its line has been written.
+typedef struct AnalysisQueue
+{
+    pthread_mutex_t lock;
+    // Signalled when a position is read or the input ends, and when lines are written.
+    pthread_cond_t queued;
+    pthread_cond_t written_out;
+    AnalysisSlot* slots;
+    uint64_t window;
+    // Positions read, handed to workers, and written out so far.
+    uint64_t read;
+    uint64_t taken;
+    uint64_t written;
+    int input_over;
+    const EngineConfig* engine;
+    uint64_t seed;
+} AnalysisQueue;
+
+typedef struct AnalysisWorker
+{
+    pthread_t thread;
+    AnalysisQueue* queue;
+    // Every worker searches with its own table.
+    TranspositionTable tt;
+} AnalysisWorker;
+
+// Function that searches one position and writes its result line: the position, the best move, the score
+// for the side to move, the depth reached, each player's valid moves and the nodes searched.
+// 'seed' makes the random choices of the greedy and mcts engines the same on every run.
+void analyzePosition(AnalysisSlot* slot, TranspositionTable* tt, const EngineConfig* engine, uint64_t seed)
+{
+    const GameState* state = &slot->state;
+    char position[POSITION_TEXT_SIZE];
+    formatPosition(state, position);
+    SearchResult result;
+    memset(&result, 0, sizeof(result));
+    char best[8] = "none";
+    if (isGameOver(state))
+    {
+        // The side to move is stuck, which is a loss.
+        result.score = -WIN_SCORE;
+    }
+    else {
+        Random rng;
+        seedRandom(&rng, seed);
+        // A position on its own has no turn limit.
+        selectMove(tt, state, engine, 0, &rng, &result);
+        formatMove(result.best, best);
+    }
+    snprintf(slot->output, sizeof(slot->output), "%s best %s score %d depth %d x_moves %d o_moves %d nodes %llu\n",
+        position, best, result.score, result.depth, state->mobility[X_INDEX], state->mobility[O_INDEX],
+        (unsigned long long)result.nodes);
+}
+
+// Function that writes the finished lines that come next in input order. Called with the lock held.
+// The workers write, not the reader, so results go out while the reader waits for more input.
+void writeFinishedLines(AnalysisQueue* queue)
+{
+    uint64_t first = queue->written;
+    while (queue->written < queue->taken && queue->slots[queue->written % queue->window].done)
+    {
+        fputs(queue->slots[queue->written % queue->window].output, stdout);
+        queue->written++;
+    }
+    if (queue->written == first)
+    {
+        return;
+    }
+    // With nothing older still being searched, the lines are handed on at once.
+    if (queue->written == queue->taken)
+    {
+        fflush(stdout);
+    }
+    pthread_cond_signal(&queue->written_out);
+}
+
+// The body of a worker: it takes the positions in input order and searches them until the input is over.
+void* runAnalysisWorker(void* arg)
+{
+    AnalysisWorker* worker = (AnalysisWorker*)arg;
+    AnalysisQueue* queue = worker->queue;
+    pthread_mutex_lock(&queue->lock);
+    while (1)
+    {
+        if (queue->taken == queue->read)
+        {
+            if (queue->input_over)
+            {
+                break;
+            }
+            pthread_cond_wait(&queue->queued, &queue->lock);
+            continue;
+        }
+        uint64_t index = queue->taken++;
+        AnalysisSlot* slot = &queue->slots[index % queue->window];
+        // A line that was not a position is finished already.
+        if (!slot->done)
+        {
+            pthread_mutex_unlock(&queue->lock);
+            analyzePosition(slot, &worker->tt, queue->engine, queue->seed + index);
+            pthread_mutex_lock(&queue->lock);
+            slot->done = 1;
+        }
+        writeFinishedLines(queue);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+// Function that analyzes every position of the input and prints a line for each. Blank lines and
+// lines starting with '#' are skipped; a line that is not a position gets an error line in its place.
+int runAnalysis(const Options* options)
+{
+    FILE* input = stdin;
+    if (strcmp(options->analyze, "-") != 0)
+    {
+        input = fopen(options->analyze, "rb");
+        if (input == NULL)
+        {
+            printf("ERROR: Could not open the positions file '%s'. \n", options->analyze);
+            return 1;
+        }
+    }
+
+    AnalysisQueue queue;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.queued, NULL);
+    pthread_cond_init(&queue.written_out, NULL);
+    queue.window = (uint64_t)options->jobs * ANALYSIS_WINDOW_PER_JOB;
+    queue.slots = (AnalysisSlot*)calloc(queue.window, sizeof(AnalysisSlot));
+    queue.read = 0;
+    queue.taken = 0;
+    queue.written = 0;
+    queue.input_over = 0;
+    queue.engine = &options->engine;
+    queue.seed = options->seed;
+    AnalysisWorker* workers = (AnalysisWorker*)calloc(options->jobs, sizeof(AnalysisWorker));
+    int started = 0;
+    int status = 0;
+    if (queue.slots == NULL || workers == NULL)
+    {
+        printf("ERROR: Out of memory for the analysis queue. \n");
+        status = 1;
+    }
+    for (int w = 0; status == 0 && w < options->jobs; w++)
+    {
+        workers[w].queue = &queue;
+        if (options->engine.kind == ENGINE_ALPHABETA && !ttInit(&workers[w].tt, options->engine.hash_mb))
+        {
+            printf("ERROR: Could not allocate a %d MB transposition table. \n", options->engine.hash_mb);
+            status = 1;
+        }
+        else if (pthread_create(&workers[w].thread, NULL, runAnalysisWorker, &workers[w]) != 0)
+        {
+            printf("ERROR: Could not start analysis worker %d. \n", w + 1);
+            ttFree(&workers[w].tt);
+            status = 1;
+        }
+        else {
+            started++;
+        }
+    }
+
+    // Positions piped in are taken as they arrive, not a block at a time.
+    LineReader reader;
+    initLineReader(&reader, input, input == stdin);
+    uint64_t line_number = 0;
+    uint64_t errors = 0;
+    uint64_t start = nowNanoseconds();
+    // Without workers nothing would ever be searched, so the input is not read at all.
+    char* line = (status == 0) ? readLine(&reader) : NULL;
+    for (; line != NULL; line = readLine(&reader))
+    {
+        line_number++;
+        while (isspace((unsigned char)*line))
+        {
+            line++;
+        }
+        if (*line == 0 || *line == '#')
+        {
+            continue;
+        }
+        // Once the slot of the next position has been written out, it is the reader's to fill.
+        pthread_mutex_lock(&queue.lock);
+        while (queue.read - queue.written == queue.window)
+        {
+            pthread_cond_wait(&queue.written_out, &queue.lock);
+        }
+        pthread_mutex_unlock(&queue.lock);
+        AnalysisSlot* slot = &queue.slots[queue.read % queue.window];
+        char error[128];
+        slot->done = !parsePosition(line, &slot->state, error, sizeof(error));
+        if (slot->done)
+        {
+            snprintf(slot->output, sizeof(slot->output), "ERROR: line %llu: %s\n", (unsigned long long)line_number, error);
+            errors++;
+        }
+        pthread_mutex_lock(&queue.lock);
+        queue.read++;
+        pthread_cond_signal(&queue.queued);
+        pthread_mutex_unlock(&queue.lock);
+    }
+    pthread_mutex_lock(&queue.lock);
+    queue.input_over = 1;
+    pthread_cond_broadcast(&queue.queued);
+    pthread_mutex_unlock(&queue.lock);
+
+    // The last worker to finish writes the last lines.
+    for (int w = 0; w < started; w++)
+    {
+        pthread_join(workers[w].thread, NULL);
+        ttFree(&workers[w].tt);
+    }
+    fflush(stdout);
+    double seconds = (nowNanoseconds() - start) / 1e9;
+    if (status == 0)
+    {
+        // The summary goes to stderr, so stdout holds nothing but the result lines.
+        fprintf(stderr, "Analyzed %llu positions (%llu not understood) in %.3f s (%.1f positions/sec) with %d job(s)\n",
+            (unsigned long long)queue.read, (unsigned long long)errors, seconds, seconds > 0 ? queue.read / seconds : 0.0,
+            options->jobs);
+    }
+    freeLineReader(&reader);
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    free(workers);
+    free(queue.slots);
+    pthread_cond_destroy(&queue.written_out);
+    pthread_cond_destroy(&queue.queued);
+    pthread_mutex_destroy(&queue.lock);
+    return status;
+}
+
+/***************************************************
+ * Game server.
+ *
+ * Many sessions at once over one line protocol on stdin and stdout. Every line
+ * names the session it is about:
+ *     <id> new x|o [pieces] [turns]   start a game as 'X' or 'O'
+ *     <id> move <from><to>            play a move, e.g. "7 move d2d3"
+ *     <id> undo | redo | show | close
+ *     quit                            finish the computer's pending moves and exit
+ * and every answer starts with the id it is for: started, moved, reply (the
+ * computer's move), position, over, closed or error. Positions are written in
+ * the notation of formatPosition().
+ *
+ * The reader thread handles the commands; the computer's moves are queued for
+ * a shared pool of workers, each with its own transposition table. A session is
+ * busy while its move is queued or searched, and its commands are refused until
+ * the reply is out.
+****************************************************/
+
+// Buckets of the table of sessions, a power of two.
+#define SERVER_BUCKETS 65536
+
+typedef struct ServerSession
+{
+    Session session;
+    uint64_t id;
+    // Set while the computer's move is queued or searched; guarded by the server lock.
+    int busy;
+    struct ServerSession* next_in_bucket;
+    struct ServerSession* next_job;
+} ServerSession;
+
+typedef struct Server
+{
+    pthread_mutex_t lock;
+    // Signalled when a job is queued or the server is stopping.
+    pthread_cond_t work;
+    ServerSession* queue_head;
+    ServerSession* queue_tail;
+    int stopping;
+    // Lines are written whole, one thread at a time.
+    pthread_mutex_t output;
+    // Everything below belongs to the reader thread.
+    ServerSession** buckets;
+    uint64_t sessions;
+    const EngineConfig* engine;
+    Random rng;
+    GameRecorder* recorder;
+} Server;
+
+typedef struct ServerWorker
+{
+    pthread_t thread;
+    Server* server;
+    TranspositionTable tt;
+    Random rng;
+} ServerWorker;
+
+// Function that writes one line of the protocol and sends it at once.
+void serverPrintf(Server* server, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&server->output);
+    vprintf(format, args);
+    fflush(stdout);
+    pthread_mutex_unlock(&server->output);
+    va_end(args);
+}
+
+// Function that returns the bucket of a session id.
+ServerSession** serverBucket(Server* server, uint64_t id)
+{
+    return &server->buckets[(id * UINT64_C(0x9E3779B97F4A7C15)) >> 48 & (SERVER_BUCKETS - 1)];
+}
+
+ServerSession* findServerSession(Server* server, uint64_t id)
+{
+    ServerSession* s = *serverBucket(server, id);
+    while (s != NULL && s->id != id)
+    {
+        s = s->next_in_bucket;
+    }
+    return s;
+}
+
+// Function that writes the present position of a session after the given word, e.g. "moved d2d3".
+void serverReportPosition(Server* server, const ServerSession* s, const char* what)
+{
+    char position[POSITION_TEXT_SIZE];
+    formatPosition(&s->session.state, position);
+    serverPrintf(server, "%llu %s %s\n", (unsigned long long)s->id, what, position);
+}
+
+// Function that writes the line announcing the end of a session's game into 'out'.
+// Returns 0, writing nothing, while the game goes on.
+int formatGameOver(ServerSession* s, char* out, size_t size)
+{
+    if (!sessionOver(&s->session))
+    {
+        return 0;
+    }
+    int winner = decideWinner(&s->session.state, s->session.game_over);
+    snprintf(out, size, "%llu over %s %s\n", (unsigned long long)s->id,
+        (winner == DRAW) ? "draw" : (winner == X_INDEX) ? "x" : "o", s->session.game_over ? "stuck" : "turns");
+    return 1;
+}
+
+// Function that moves a session on after the user changed it: it announces the end of the game,
+// or queues the computer's move when it is the computer's turn.
+void serverAdvance(Server* server, ServerSession* s)
+{
+    char over[64];
+    if (formatGameOver(s, over, sizeof(over)))
+    {
+        serverPrintf(server, "%s", over);
+        return;
+    }
+    if (sessionUserToMove(&s->session))
+    {
+        return;
+    }
+    pthread_mutex_lock(&server->lock);
+    s->busy = 1;
+    s->next_job = NULL;
+    if (server->queue_tail)
+    {
+        server->queue_tail->next_job = s;
+    }
+    else {
+        server->queue_head = s;
+    }
+    server->queue_tail = s;
+    pthread_cond_signal(&server->work);
+    pthread_mutex_unlock(&server->lock);
+}
+
+// The body of a worker: it searches the computer's moves in the order they were queued.
+void* runServerWorker(void* arg)
+{
+    ServerWorker* worker = (ServerWorker*)arg;
+    Server* server = worker->server;
+    pthread_mutex_lock(&server->lock);
+    while (1)
+    {
+        ServerSession* s = server->queue_head;
+        if (s == NULL)
+        {
+            if (server->stopping)
+            {
+                break;
+            }
+            pthread_cond_wait(&server->work, &server->lock);
+            continue;
+        }
+        server->queue_head = s->next_job;
+        if (server->queue_head == NULL)
+        {
+            server->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        // The session is busy, so the reader leaves it alone until the reply is out.
+        SearchResult result;
+        Move move = selectMove(&worker->tt, &s->session.state, server->engine, s->session.turns - s->session.turn_count,
+            &worker->rng, &result);
+        char lines[2 * POSITION_TEXT_SIZE + 64];
+        if (sessionPlay(&s->session, move))
+        {
+            char text[5];
+            char position[POSITION_TEXT_SIZE];
+            formatMove(move, text);
+            formatPosition(&s->session.state, position);
+            int length = snprintf(lines, sizeof(lines), "%llu reply %s %s\n", (unsigned long long)s->id, text, position);
+            // After a reply it is the user's turn, unless the game is over.
+            formatGameOver(s, lines + length, sizeof(lines) - length);
+        }
+        else {
+            snprintf(lines, sizeof(lines), "%llu error out of memory for the game history\n", (unsigned long long)s->id);
+        }
+
+        // The session is let go under the output lock, so a command the reply prompts is answered after it.
+        pthread_mutex_lock(&server->output);
+        pthread_mutex_lock(&server->lock);
+        s->busy = 0;
+        pthread_mutex_unlock(&server->lock);
+        fputs(lines, stdout);
+        fflush(stdout);
+        pthread_mutex_unlock(&server->output);
+        pthread_mutex_lock(&server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+// Function that reads a move written as two cells, e.g. "d2d3", and checks that the player to move may play it.
+int parseMove(const GameState* state, const char* text, Move* move)
+{
+    if (strlen(text) != 4)
+    {
+        return 0;
+    }
+    int from = cellFromString(text);
+    int to = cellFromString(text + 2);
+    if (from < 0 || to < 0 || !(state->board.pieces[state->side] & (UINT64_C(1) << from))
+        || !(stepTargets(UINT64_C(1) << from, emptyCells(&state->board)) & (UINT64_C(1) << to)))
+    {
+        return 0;
+    }
+    move->from = (uint8_t)from;
+    move->to = (uint8_t)to;
+    return 1;
+}
+
+// Function that ends a session: a finished game goes to the archive, and the memory is released.
+void closeServerSession(Server* server, ServerSession* s)
+{
+    ServerSession** link = serverBucket(server, s->id);
+    while (*link != s)
+    {
+        link = &(*link)->next_in_bucket;
+    }
+    *link = s->next_in_bucket;
+    if (server->recorder && sessionOver(&s->session))
+    {
+        recordSession(server->recorder, &s->session);
+    }
+    freeSession(&s->session);
+    free(s);
+    server->sessions--;
+}
+
+// Function that carries out one line of the protocol. Returns 0 when the line asks the server to quit.
+int handleServerCommand(Server* server, char* line)
+{
+    while (isspace((unsigned char)*line))
+    {
+        line++;
+    }
+    if (*line == 0 || *line == '#')
+    {
+        return 1;
+    }
+    if (strcmp(line, "quit") == 0)
+    {
+        return 0;
+    }
+    char* end;
+    uint64_t id = strtoull(line, &end, 10);
+    char* command = strtok(end, " \t");
+    if (end == line || !isdigit((unsigned char)*line) || command == NULL)
+    {
+        serverPrintf(server, "error expected '<id> <command>'\n");
+        return 1;
+    }
+    char* args[3];
+    int count = 0;
+    for (char* arg = strtok(NULL, " \t"); arg != NULL; arg = strtok(NULL, " \t"))
+    {
+        if (count == 3)
+        {
+            serverPrintf(server, "%llu error too many arguments\n", (unsigned long long)id);
+            return 1;
+        }
+        args[count++] = arg;
+    }
+
+    ServerSession* s = findServerSession(server, id);
+    if (strcmp(command, "new") == 0)
+    {
+        int user = (count >= 1 && strlen(args[0]) == 1) ? toupper((unsigned char)args[0][0]) : 0;
+        int pieces = (count >= 2) ? atoi(args[1]) : DEFAULT_PIECES;
+        int turns = (count >= 3) ? atoi(args[2]) : DEFAULT_TURNS;
+        if (s != NULL)
+        {
+            serverPrintf(server, "%llu error the session is already open\n", (unsigned long long)id);
+        }
+        else if (user != PLAYER_ONE && user != PLAYER_TWO)
+        {
+            serverPrintf(server, "%llu error expected 'new x|o [pieces] [turns]'\n", (unsigned long long)id);
+        }
+        else if (pieces < 1 || pieces > MAX_PIECES || turns < 1)
+        {
+            serverPrintf(server, "%llu error pieces must be 1 to %d and turns at least 1\n", (unsigned long long)id, MAX_PIECES);
+        }
+        else if ((s = (ServerSession*)calloc(1, sizeof(ServerSession))) == NULL)
+        {
+            serverPrintf(server, "%llu error out of memory\n", (unsigned long long)id);
+        }
+        else {
+            PROFILE_ALLOCATION();
+            s->id = id;
+            initSession(&s->session);
+            startSession(&s->session, playerIndex((char)user), pieces, turns, &server->rng);
+            ServerSession** bucket = serverBucket(server, id);
+            s->next_in_bucket = *bucket;
+            *bucket = s;
+            server->sessions++;
+            serverReportPosition(server, s, "started");
+            serverAdvance(server, s);
+        }
+        return 1;
+    }
+    if (s == NULL)
+    {
+        serverPrintf(server, "%llu error no such session\n", (unsigned long long)id);
+        return 1;
+    }
+    pthread_mutex_lock(&server->lock);
+    int busy = s->busy;
+    pthread_mutex_unlock(&server->lock);
+    if (busy)
+    {
+        serverPrintf(server, "%llu error the computer is thinking\n", (unsigned long long)id);
+        return 1;
+    }
+
+    Move move;
+    if (strcmp(command, "move") == 0)
+    {
+        if (sessionOver(&s->session))
+        {
+            serverPrintf(server, "%llu error the game is over\n", (unsigned long long)id);
+        }
+        else if (count != 1 || !parseMove(&s->session.state, args[0], &move))
+        {
+            serverPrintf(server, "%llu error expected a legal move such as 'move d2d3'\n", (unsigned long long)id);
+        }
+        else if (!sessionPlay(&s->session, move))
+        {
+            serverPrintf(server, "%llu error out of memory for the game history\n", (unsigned long long)id);
+        }
+        else {
+            char what[16] = "moved ";
+            formatMove(move, what + 6);
+            serverReportPosition(server, s, what);
+            serverAdvance(server, s);
+        }
+    }
+    else if (strcmp(command, "undo") == 0 || strcmp(command, "redo") == 0)
+    {
+        int undo = (command[0] == 'u');
+        if (undo ? !sessionTakeBack(&s->session) : !sessionRedo(&s->session))
+        {
+            serverPrintf(server, "%llu error %s\n", (unsigned long long)id, undo ? "no move of yours to take back" : "no move to redo");
+        }
+        else {
+            serverReportPosition(server, s, "position");
+            serverAdvance(server, s);
+        }
+    }
+    else if (strcmp(command, "show") == 0)
+    {
+        serverReportPosition(server, s, "position");
+    }
+    else if (strcmp(command, "close") == 0)
+    {
+        closeServerSession(server, s);
+        serverPrintf(server, "%llu closed\n", (unsigned long long)id);
+    }
+    else {
+        serverPrintf(server, "%llu error unknown command '%s'\n", (unsigned long long)id, command);
+    }
+    return 1;
+}
+
+// Function that serves the line protocol on stdin and stdout until 'quit' or the end of the input.
+int runServer(const Options* options)
+{
+    Server server;
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.work, NULL);
+    pthread_mutex_init(&server.output, NULL);
+    server.queue_head = NULL;
+    server.queue_tail = NULL;
+    server.stopping = 0;
+    server.sessions = 0;
+    server.engine = &options->engine;
+    seedRandom(&server.rng, options->seed_given ? options->seed : clockSeed());
+    server.recorder = NULL;
+    server.buckets = (ServerSession**)calloc(SERVER_BUCKETS, sizeof(ServerSession*));
+    ServerWorker* workers = (ServerWorker*)calloc(options->jobs, sizeof(ServerWorker));
+    GameRecorder recorder;
+    int started = 0;
+    int status = 0;
+    if (server.buckets == NULL || workers == NULL)
+    {
+        printf("ERROR: Out of memory for the server. \n");
+        status = 1;
+    }
+    else if (options->record != NULL && !openRecorder(&recorder, options->record))
+    {
+        printf("ERROR: Could not open the game archive '%s'. \n", options->record);
+        status = 1;
+    }
+    else if (options->record != NULL)
+    {
+        server.recorder = &recorder;
+    }
+    for (int w = 0; status == 0 && w < options->jobs; w++)
+    {
+        workers[w].server = &server;
+        seedRandom(&workers[w].rng, server.rng.state + w + 1);
+        if (options->engine.kind == ENGINE_ALPHABETA && !ttInit(&workers[w].tt, options->engine.hash_mb))
+        {
+            printf("ERROR: Could not allocate a %d MB transposition table. \n", options->engine.hash_mb);
+            status = 1;
+        }
+        else if (pthread_create(&workers[w].thread, NULL, runServerWorker, &workers[w]) != 0)
+        {
+            printf("ERROR: Could not start server worker %d. \n", w + 1);
+            ttFree(&workers[w].tt);
+            status = 1;
+        }
+        else {
+            started++;
+        }
+    }
+
+    if (status == 0)
+    {
+        serverPrintf(&server, "ready\n");
+        LineReader reader;
+        initLineReader(&reader, stdin, 1);
+        char* line;
+        while ((line = readLine(&reader)) != NULL && handleServerCommand(&server, line))
+        {
+        }
+        freeLineReader(&reader);
+    }
+
+    // The workers answer every queued move before they stop.
+    pthread_mutex_lock(&server.lock);
+    server.stopping = 1;
+    pthread_cond_broadcast(&server.work);
+    pthread_mutex_unlock(&server.lock);
+    for (int w = 0; w < started; w++)
+    {
+        pthread_join(workers[w].thread, NULL);
+        ttFree(&workers[w].tt);
+    }
+    for (int b = 0; server.buckets != NULL && b < SERVER_BUCKETS; b++)
+    {
+        while (server.buckets[b] != NULL)
+        {
+            closeServerSession(&server, server.buckets[b]);
+        }
+    }
+    if (server.recorder && !closeRecorder(server.recorder))
+    {
+        printf("ERROR: Could not write the game archive '%s'. \n", options->record);
+        status = 1;
+    }
+    free(workers);
+    free(server.buckets);
+    pthread_mutex_destroy(&server.output);
+    pthread_cond_destroy(&server.work);
+    pthread_mutex_destroy(&server.lock);
+    return status;
+}
+
+/***************************************************
+ * Benchmarks.
+ *
+ * Perft (the number of positions reached after exactly N moves) from seeded
+ * start positions, checked against reference counts, and microbenchmarks
+ * of the functions the game and the search call most.
+****************************************************/
+
+// Function that counts the positions reached after exactly 'depth' moves.
+// A line where the player to move is stuck ends early and adds nothing.
+uint64_t perft(GameState* state, int depth)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+    if (depth == 1)
+    {
+        // Every valid move leads to exactly one position, and the state already counts them.
+        return (uint64_t)state->mobility[state->side];
+    }
+    MoveList list;
+    generateMoves(&state->board, state->side, &list);
+    uint64_t total = 0;
+    for (int i = 0; i < list.count; i++)
+    {
+        UndoRecord undo;
+        makeMove(state, list.moves[i], &undo);
+        total += perft(state, depth - 1);
+        unmakeMove(state, &undo);
+    }
+    return total;
+}
+
+// A perft count known to be right, for the start position set up by initializeBoard() from the seed.
+typedef struct PerftReference
+{
+    uint64_t seed;
+    int pieces;
+    int depth;
+    uint64_t count;
+} PerftReference;
+
+const PerftReference perft_references[] = {
+    { 1, 1, 7, 5931 },
+    { 2, 4, 6, 2035442 },
+    { 3, 8, 6, 28763045 },
+    { 4, 12, 5, 4647673 },
+    { 5, 20, 6, 8137087 },
+    { 6, 24, 5, 9 },
+};
+
+// Function that sets up the seeded start position used by perft and the microbenchmarks.
+void seededStartState(uint64_t seed, int pieces, GameState* state)
+{
+    BitBoard board;
+    Random rng;
+    seedRandom(&rng, seed);
+    initializeBoard(&board, pieces, &rng);
+    initGameState(state, &board, X_INDEX);
+}
+
+// Function that runs perft from the seeded start position to every depth up to 'max_depth'.
+void runPerft(uint64_t seed, int pieces, int max_depth)
+{
+    GameState state;
+    seededStartState(seed, pieces, &state);
+    printf("Perft from seed %llu, %d pieces per player:\n", (unsigned long long)seed, pieces);
+    printBoard(&state.board);
+    for (int depth = 1; depth <= max_depth; depth++)
+    {
+        uint64_t start = nowNanoseconds();
+        uint64_t count = perft(&state, depth);
+        double seconds = (nowNanoseconds() - start) / 1e9;
+        printf("depth %2d: %15llu positions in %8.3f s (%.0f positions/sec)\n", depth, (unsigned long long)count, seconds,
+            seconds > 0 ? count / seconds : 0.0);
+    }
+}
+
+// Function that checks every reference perft count. Returns the number of mismatches.
+int checkPerftReferences(void)
+{
+    int failures = 0;
+    uint64_t positions = 0;
+    uint64_t start = nowNanoseconds();
+    int count = (int)(sizeof(perft_references) / sizeof(perft_references[0]));
+    printf("Perft reference counts:\n");
+    for (int i = 0; i < count; i++)
+    {
+        const PerftReference* ref = &perft_references[i];
+        GameState state;
+        seededStartState(ref->seed, ref->pieces, &state);
+        uint64_t got = perft(&state, ref->depth);
+        positions += got;
+        printf("  seed %llu, %2d pieces, depth %d: %12llu %s\n", (unsigned long long)ref->seed, ref->pieces, ref->depth, (unsigned long long)got,
+            got == ref->count ? "ok" : "MISMATCH");
+        if (got != ref->count)
+        {
+            printf("    expected %llu\n", (unsigned long long)ref->count);
+            failures++;
+        }
+    }
+    double seconds = (nowNanoseconds() - start) / 1e9;
+    printf("  %d of %d match, %.0f positions/sec\n\n", count - failures, count, seconds > 0 ? positions / seconds : 0.0);
+    return failures;
+}
+
+// Positions the microbenchmarks cycle through.
+#define BENCH_POSITIONS 1024
+// Passes over those positions per microbenchmark.
+#define BENCH_PASSES 2000
+
+// Keeps the compiler from dropping the benchmarked calls.
+volatile uint64_t bench_sink;
+
+// Function that fills 'states' with varied positions, seeded setups played forward by random moves,
+// and 'moves' with a valid move in each of them.
+void makeBenchPositions(GameState* states, Move* moves, int count)
+{
+    Random rng;
+    seedRandom(&rng, 12345);
+    for (int i = 0; i < count; i++)
+    {
+        BitBoard board;
+        initializeBoard(&board, 2 + i % (MAX_PIECES - 1), &rng);
+        initGameState(&states[i], &board, X_INDEX);
+        int plies = randomBelow(&rng, 20);
+        MoveList list;
+        for (int p = 0; p < plies && !isGameOver(&states[i]); p++)
+        {
+            generateMoves(&states[i].board, states[i].side, &list);
+            applyMove(&states[i], list.moves[randomBelow(&rng, list.count)]);
+        }
+        if (isGameOver(&states[i]))
+        {
+            // Only positions with a move to play are kept.
+            i--;
+            continue;
+        }
+        generateMoves(&states[i].board, states[i].side, &list);
+        moves[i] = list.moves[randomBelow(&rng, list.count)];
+    }
+}
+
+// Function that prints one microbenchmark line.
+void reportBench(const char* name, uint64_t start, uint64_t ops)
+{
+    double ns = (double)(nowNanoseconds() - start);
+    printf("  %-42s %8.2f ns/op %14.0f ops/sec\n", name, ns / ops, ops / (ns / 1e9));
+}
+
+// Function that times the hot paths of the game and the search.
+// Returns the number of batch evaluation kernels that disagree with the scalar count.
+int runMicrobenchmarks(void)
+{
+    int failures = 0;
+    GameState* states = (GameState*)malloc(BENCH_POSITIONS * sizeof(GameState));
+    Move* moves = (Move*)malloc(BENCH_POSITIONS * sizeof(Move));
+    makeBenchPositions(states, moves, BENCH_POSITIONS);
+    uint64_t ops = (uint64_t)BENCH_POSITIONS * BENCH_PASSES;
+    uint64_t sink = 0;
+    printf("Microbenchmarks over %d positions:\n", BENCH_POSITIONS);
+
+    uint64_t start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            MoveList list;
+            generateMoves(&states[i].board, states[i].side, &list);
+            sink += list.count;
+        }
+    }
+    reportBench("move generation (generateMoves)", start, ops);
+
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            GameState child = states[i];
+            applyMove(&child, moves[i]);
+            sink += child.hashes[0];
+        }
+    }
+    reportBench("copy and make a move (applyMove)", start, ops);
+
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            UndoRecord undo;
+            makeMove(&states[i], moves[i], &undo);
+            sink += states[i].hashes[0];
+            unmakeMove(&states[i], &undo);
+        }
+    }
+    reportBench("make and unmake a move (makeMove)", start, ops);
+
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            sink += isGameOver(&states[i]);
+        }
+    }
+    reportBench("game-over detection (isGameOver)", start, ops);
+
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            sink += stepTargets(states[i].board.pieces[states[i].side], emptyCells(&states[i].board)) == 0;
+        }
+    }
+    reportBench("game-over detection from the board", start, ops);
+
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            sink += evaluate(&states[i]);
+        }
+    }
+    reportBench("heuristic evaluation (evaluate)", start, ops);
+
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            sink += countPlayerValidMoves(&states[i].board, PLAYER_ONE) - countPlayerValidMoves(&states[i].board, PLAYER_TWO);
+        }
+    }
+    reportBench("heuristic evaluation from the board", start, ops);
+
+    // The same boards in structure-of-arrays form for the batch evaluation, timed with every kernel
+    // this processor runs and checked against countPlayerValidMoves().
+    uint64_t* x_pieces = (uint64_t*)malloc(BENCH_POSITIONS * sizeof(uint64_t));
+    uint64_t* o_pieces = (uint64_t*)malloc(BENCH_POSITIONS * sizeof(uint64_t));
+    int32_t* results = (int32_t*)malloc(3 * BENCH_POSITIONS * sizeof(int32_t));
+    BoardBatch batch = { BENCH_POSITIONS, x_pieces, o_pieces, results, results + BENCH_POSITIONS, results + 2 * BENCH_POSITIONS };
+    for (int i = 0; i < BENCH_POSITIONS; i++)
+    {
+        x_pieces[i] = states[i].board.pieces[X_INDEX];
+        o_pieces[i] = states[i].board.pieces[O_INDEX];
+    }
+    double scalar_ns = 0;
+    for (int kernel = BATCH_SCALAR; kernel <= batchKernel(); kernel++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "batch evaluation (%s)", batch_kernel_names[kernel]);
+        memset(results, 0xff, 3 * BENCH_POSITIONS * sizeof(int32_t));
+        start = nowNanoseconds();
+        for (int pass = 0; pass < BENCH_PASSES; pass++)
+        {
+            evaluateBatchWith(&batch, kernel);
+            sink += batch.scores[pass % BENCH_POSITIONS];
+        }
+        double ns = (double)(nowNanoseconds() - start);
+        reportBench(name, start, ops);
+        if (kernel == BATCH_SCALAR)
+        {
+            scalar_ns = ns;
+        }
+        else {
+            printf("  %-42s %8.2fx\n", "  boards/sec over the scalar kernel", scalar_ns / ns);
+        }
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            int x_moves = countPlayerValidMoves(&states[i].board, PLAYER_ONE);
+            int o_moves = countPlayerValidMoves(&states[i].board, PLAYER_TWO);
+            if (batch.x_moves[i] != x_moves || batch.o_moves[i] != o_moves || batch.scores[i] != x_moves - o_moves)
+            {
+                printf("  MISMATCH: the %s kernel scores board %d as %d - %d, not %d - %d\n", batch_kernel_names[kernel], i,
+                    batch.x_moves[i], batch.o_moves[i], x_moves, o_moves);
+                failures++;
+                break;
+            }
+        }
+    }
+    free(results);
+    free(o_pieces);
+    free(x_pieces);
+
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES / 10; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            GameState copy;
+            initGameState(&copy, &states[i].board, states[i].side);
+            sink += copy.hashes[0];
+        }
+    }
+    reportBench("state setup (initGameState)", start, ops / 10);
+
+    Random rng;
+    seedRandom(&rng, 1);
+    start = nowNanoseconds();
+    for (int pass = 0; pass < BENCH_PASSES / 10; pass++)
+    {
+        for (int i = 0; i < BENCH_POSITIONS; i++)
+        {
+            BitBoard board;
+            initializeBoard(&board, MAX_PIECES, &rng);
+            sink += board.pieces[O_INDEX];
+        }
+    }
+    reportBench("board setup (initializeBoard, 24 pieces)", start, ops / 10);
+
+    bench_sink = sink;
+    free(moves);
+    free(states);
+    return failures;
+}
+
+// Function that checks that the search only trusts the tablebase before the turn limit. A table where every
+// one-piece position is won in one ply stands in for the loaded one. Returns the number of failures.
+int checkTablebaseTurnLimit(void)
+{
+    initTablebaseIndexing();
+    uint8_t* values = (uint8_t*)malloc(tablebaseSize(1));
+    TranspositionTable tt;
+    if (values == NULL || !ttInit(&tt, 1))
+    {
+        printf("ERROR: Out of memory for the tablebase check. \n");
+        free(values);
+        return 1;
+    }
+    // Entry 2: the player to move wins in 1 ply.
+    memset(values, 2, tablebaseSize(1));
+    Tablebase loaded = tablebase;
+    memset(&tablebase, 0, sizeof(tablebase));
+    tablebase.max_pieces = 1;
+    tablebase.tables[1] = values;
+
+    BitBoard board;
+    memset(&board, 0, sizeof(board));
+    board.pieces[X_INDEX] = UINT64_C(1) << CELL(2, 2);
+    board.pieces[O_INDEX] = UINT64_C(1) << CELL(4, 4);
+    GameState state;
+    initGameState(&state, &board, X_INDEX);
+    atomic_int stop;
+    atomic_init(&stop, 0);
+
+    // Positions 'ply' plies into searches with the limit 'plies_left' plies away, and whether the entry holds there.
+    static const struct { int plies_left; int ply; int trusted; } cases[] = {
+        { 0, 1, 1 }, { 3, 1, 1 }, { 2, 1, 0 }, { 1, 1, 0 }, { 1, 2, 0 },
+    };
+    int count = (int)(sizeof(cases) / sizeof(cases[0]));
+    int failures = 0;
+    printf("Tablebase probes against the turn limit:\n");
+    for (int i = 0; i < count; i++)
+    {
+        SearchContext ctx = { &tt, 0, 0, &stop, 0, 0, cases[i].plies_left };
+        ttClear(&tt);
+        int score = negamax(&ctx, &state, 2, -WIN_SCORE - 1, WIN_SCORE + 1, cases[i].ply);
+        int trusted = score == tablebaseScore(2, cases[i].ply);
+        printf("  limit %d plies, probe at ply %d: %s %s\n", cases[i].plies_left, cases[i].ply,
+            trusted ? "trusted" : "searched", trusted == cases[i].trusted ? "ok" : "MISMATCH");
+        failures += trusted != cases[i].trusted;
+    }
+    printf("  %d of %d match\n\n", count - failures, count);
+
+    ttFree(&tt);
+    tablebase = loaded;
+    free(values);
+    return failures;
+}
+
+// Function that runs the whole benchmark suite. Returns nonzero if a perft count, a tablebase probe or a
+// batch evaluation is wrong.
+int runBenchmarks(void)
+{
+    int failures = checkPerftReferences();
+    failures += checkTablebaseTurnLimit();
+    failures += runMicrobenchmarks();
+    return failures != 0;
+}
+
+// Function that prints the command line options.
+void printUsage(const char* program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  --engine SPEC               engine playing the computer's side (default alphabeta)\n");
+    printf("  --depth N                   alpha-beta search depth in plies (default %d)\n", DEFAULT_DEPTH);
+    printf("  --movetime-ms N             time budget per computer move; deepens until it runs out\n");
+    printf("  --hash-mb N                 transposition table size in megabytes (default %d)\n", DEFAULT_HASH_MB);
+    printf("  --threads N                 search threads sharing the transposition table (default 1)\n");
+    printf("  --script FILE               answer the prompts from FILE ('-' for stdin), game after game until it ends\n");
+    printf("  --playouts N                playouts per move of the mcts engine (default %d)\n", DEFAULT_PLAYOUTS);
+    printf("  --mcts-nodes N              most tree nodes the mcts engine allocates (default %d)\n", DEFAULT_MCTS_NODES);
+    printf("  --analyze FILE              print the best move and score of every position in FILE ('-' for stdin) and exit\n");
+    printf("  --jobs N                    worker threads of --analyze, --server and --tournament (default: one per processor)\n");
+    printf("  --record FILE               append every finished game to the binary archive FILE\n");
+    printf("  --replay FILE               replay and check every game of the archive FILE and exit\n");
+    printf("  --tournament N              play N openings, twice with colours swapped, between every pair of entrants\n");
+    printf("  --entrant SPEC              add an engine to the tournament (at least two, at most %d)\n", TOURNAMENT_MAX_ENTRANTS);
+    printf("  --sprt ELO0,ELO1            stop the tournament once the first entrant is shown to be ELO0 or ELO1 stronger\n");
+    printf("  --server                    serve many games over a line protocol on stdin/stdout (see --jobs)\n");
+    printf("  --ponder                    let the alpha-beta engine search while you think about your move\n");
+    printf("  --profile FILE              write per-turn and per-run counters of the hot functions to FILE, as JSON\n");
+    printf("                              lines if it ends in .json, CSV otherwise (builds with -DXO_PROFILE only)\n");
+    printf("  --quiet                     show nothing of the game but the final results\n");
+    printf("  --diff                      draw the board once and redraw only the cells each move changes (ANSI)\n");
+    printf("  --smp-speedup               measure the speedup of --threads over one thread and exit\n");
+    printf("  --selfplay N                play N computer-against-computer games without any prompts\n");
+    printf("  --pieces N                  pieces per player in self-play (default %d)\n", DEFAULT_PIECES);
+    printf("  --turns N                   turn limit of each self-play game (default %d)\n", DEFAULT_TURNS);
+    printf("  --size N                    play the interactive game or self-play on an NxN board, 2 to %d (default %d)\n",
+        WIDE_MAX_SIDE, SIDE);
+    printf("  --seed N                    seed of the board setups (default 1; an interactive game without it uses the clock)\n");
+    printf("  --x-engine SPEC             engine playing 'X' in self-play (default: --engine)\n");
+    printf("  --o-engine SPEC             engine playing 'O' in self-play (default: --engine)\n");
+    printf("  --bench                     check the perft reference counts and tablebase probes, run the microbenchmarks and exit\n");
+    printf("  --perft N                   count positions to depths 1..N from the --seed/--pieces setup and exit\n");
+    printf("  --tb-generate N             solve every position with up to N pieces per side (max %d) into --tb-file and exit\n",
+        TB_MAX_PIECES);
+    printf("  --tb-file PATH              endgame tablebase the computer plays from (default %s, used if present)\n",
+        TB_DEFAULT_FILE);
+    printf("  --help                      show this message\n");
+    printf("SPEC is 'greedy', 'alphabeta' or 'mcts', optionally followed by settings, e.g. alphabeta:depth=4,hash=8\n");
+    printf("(settings: depth, movetime, threads, hash, playouts, nodes).\n");
+}
+
+// Function that applies one engine setting, given by name. Returns 0 if the setting is bad.
+// A time budget without a depth lets the clock alone decide how deep to search.
+int setEngineOption(EngineConfig* engine, const char* name, const char* value, int* depth_given)
+{
+    int n = atoi(value);
+    if (strcmp(name, "depth") == 0)
+    {
+        if (n < 1 || n > MAX_DEPTH)
+        {
+            printf("ERROR: Search depth must be between 1 and %d. \n", MAX_DEPTH);
+            return 0;
+        }
+        engine->depth = n;
+        *depth_given = 1;
+    }
+    else if (strcmp(name, "movetime") == 0)
+    {
+        if (n < 1)
+        {
+            printf("ERROR: Move time must be at least 1 ms. \n");
+            return 0;
+        }
+        engine->movetime_ms = n;
+        if (!*depth_given)
+        {
+            engine->depth = MAX_DEPTH;
+        }
+    }
+    else if (strcmp(name, "threads") == 0)
+    {
+        if (n < 1 || n > MAX_THREADS)
+        {
+            printf("ERROR: Thread count must be between 1 and %d. \n", MAX_THREADS);
+            return 0;
+        }
+        engine->threads = n;
+    }
+    else if (strcmp(name, "playouts") == 0)
+    {
+        if (n < 1)
+        {
+            printf("ERROR: Playouts per move must be at least 1. \n");
+            return 0;
+        }
+        engine->playouts = n;
+    }
+    else if (strcmp(name, "nodes") == 0)
+    {
+        if (n < 1)
+        {
+            printf("ERROR: The tree must hold at least 1 node. \n");
+            return 0;
+        }
+        engine->mcts_nodes = n;
+    }
+    else if (strcmp(name, "hash") == 0)
+    {
+        if (n < 1)
+        {
+            printf("ERROR: Transposition table size must be at least 1 MB. \n");
+            return 0;
+        }
+        engine->hash_mb = n;
+    }
+    else {
+        printf("ERROR: Unknown engine setting '%s'. \n", name);
+        return 0;
+    }
+    return 1;
+}
+
+// Function that reads an engine description such as "greedy" or "alphabeta:depth=8,movetime=100"
+// on top of the settings already in 'engine'. Returns 0 if the description is not understood.
+int parseEngineSpec(const char* spec, EngineConfig* engine)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+    char* settings = strchr(buffer, ':');
+    if (settings)
+    {
+        *settings++ = 0;
+    }
+
+    if (strcmp(buffer, "greedy") == 0)
+    {
+        engine->kind = ENGINE_GREEDY;
+    }
+    else if (strcmp(buffer, "alphabeta") == 0)
+    {
+        engine->kind = ENGINE_ALPHABETA;
+    }
+    else if (strcmp(buffer, "mcts") == 0)
+    {
+        engine->kind = ENGINE_MCTS;
+    }
+    else {
+        printf("ERROR: Unknown engine '%s'. \n", buffer);
+        return 0;
+    }
+
+    // The settings are a comma separated list of name=value pairs.
+    int depth_given = 0;
+    for (char* item = settings ? strtok(settings, ",") : NULL; item; item = strtok(NULL, ","))
+    {
+        char* value = strchr(item, '=');
+        if (!value)
+        {
+            printf("ERROR: Engine setting '%s' needs a value. \n", item);
+            return 0;
+        }
+        *value++ = 0;
+        if (!setEngineOption(engine, item, value, &depth_given))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function that reads the command line options. Returns 0 on a bad option.
+int parseOptions(int argc, char** argv, Options* options)
+{
+    EngineConfig* engine = &options->engine;
+    options->mode = MODE_PLAY;
+    options->games = 0;
+    options->pieces = DEFAULT_PIECES;
+    options->size = SIDE;
+    options->turns = DEFAULT_TURNS;
+    options->seed = 1;
+    options->seed_given = 0;
+    options->output = OUTPUT_NORMAL;
+    options->script = NULL;
+    options->ponder = 0;
+    options->analyze = NULL;
+    options->record = NULL;
+    options->replay = NULL;
+    options->profile = NULL;
+    options->openings = 0;
+    options->entrant_count = 0;
+    options->sprt = 0;
+    options->jobs = processorCount();
+    options->tb_file = TB_DEFAULT_FILE;
+    options->tb_file_given = 0;
+    options->tb_pieces = 0;
+    engine->threads = 1;
+    engine->kind = ENGINE_ALPHABETA;
+    engine->depth = DEFAULT_DEPTH;
+    engine->hash_mb = DEFAULT_HASH_MB;
+    engine->movetime_ms = 0;
+    engine->playouts = DEFAULT_PLAYOUTS;
+    engine->mcts_nodes = DEFAULT_MCTS_NODES;
+    int depth_given = 0;
+    // The per-side and tournament engine descriptions are applied last, on top of the shared settings.
+    const char* side_specs[2] = { NULL, NULL };
+    const char* entrant_specs[TOURNAMENT_MAX_ENTRANTS];
+    for (int i = 1; i < argc; i++)
+    {
+        // Options that take a value read it from the next argument.
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--engine") == 0 && value)
+        {
+            if (!parseEngineSpec(value, engine))
+            {
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && value)
+        {
+            if (!setEngineOption(engine, "depth", value, &depth_given))
+            {
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--movetime-ms") == 0 && value)
+        {
+            if (!setEngineOption(engine, "movetime", value, &depth_given))
+            {
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && value)
+        {
+            if (!setEngineOption(engine, "threads", value, &depth_given))
+            {
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--hash-mb") == 0 && value)
+        {
+            if (!setEngineOption(engine, "hash", value, &depth_given))
+            {
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--playouts") == 0 && value)
+        {
+            if (!setEngineOption(engine, "playouts", value, &depth_given))
+            {
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--mcts-nodes") == 0 && value)
+        {
+            if (!setEngineOption(engine, "nodes", value, &depth_given))
+            {
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--smp-speedup") == 0)
+        {
+            options->mode = MODE_SPEEDUP;
+        }
+        else if (strcmp(argv[i], "--selfplay") == 0 && value)
+        {
+            options->mode = MODE_SELFPLAY;
+            options->games = atol(value);
+            if (options->games < 1)
+            {
+                printf("ERROR: Number of games must be at least 1. \n");
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--script") == 0 && value)
+        {
+            options->script = value;
+            i++;
+        }
+        else if (strcmp(argv[i], "--analyze") == 0 && value)
+        {
+            options->mode = MODE_ANALYZE;
+            options->analyze = value;
+            i++;
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && value)
+        {
+            options->jobs = atoi(value);
+            if (options->jobs < 1 || options->jobs > MAX_THREADS)
+            {
+                printf("ERROR: Job count must be between 1 and %d. \n", MAX_THREADS);
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--record") == 0 && value)
+        {
+            options->record = value;
+            i++;
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && value)
+        {
+            options->mode = MODE_REPLAY;
+            options->replay = value;
+            i++;
+        }
+        else if (strcmp(argv[i], "--tournament") == 0 && value)
+        {
+            options->mode = MODE_TOURNAMENT;
+            options->openings = atol(value);
+            if (options->openings < 1)
+            {
+                printf("ERROR: A tournament needs at least 1 opening. \n");
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--entrant") == 0 && value)
+        {
+            if (options->entrant_count == TOURNAMENT_MAX_ENTRANTS)
+            {
+                printf("ERROR: A tournament holds at most %d entrants. \n", TOURNAMENT_MAX_ENTRANTS);
+                return 0;
+            }
+            entrant_specs[options->entrant_count++] = value;
+            i++;
+        }
+        else if (strcmp(argv[i], "--sprt") == 0 && value)
+        {
+            if (sscanf(value, "%lf,%lf", &options->sprt_elo[0], &options->sprt_elo[1]) != 2
+                || options->sprt_elo[0] >= options->sprt_elo[1])
+            {
+                printf("ERROR: The sequential test needs two Elo bounds, the lower first, e.g. 0,10. \n");
+                return 0;
+            }
+            options->sprt = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], "--server") == 0)
+        {
+            options->mode = MODE_SERVER;
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && value)
+        {
+#ifdef XO_PROFILE
+            options->profile = value;
+            i++;
+#else
+            printf("ERROR: This build has no instrumentation; compile with -DXO_PROFILE to use --profile. \n");
+            return 0;
+#endif
+        }
+        else if (strcmp(argv[i], "--ponder") == 0)
+        {
+            options->ponder = 1;
+        }
+        else if (strcmp(argv[i], "--quiet") == 0)
+        {
+            options->output = OUTPUT_QUIET;
+        }
+        else if (strcmp(argv[i], "--diff") == 0)
+        {
+            options->output = OUTPUT_DIFF;
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            options->mode = MODE_BENCH;
+        }
+        else if (strcmp(argv[i], "--perft") == 0 && value)
+        {
+            options->mode = MODE_PERFT;
+            options->perft_depth = atoi(value);
+            if (options->perft_depth < 1 || options->perft_depth > MAX_DEPTH)
+            {
+                printf("ERROR: Perft depth must be between 1 and %d. \n", MAX_DEPTH);
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--tb-generate") == 0 && value)
+        {
+            options->mode = MODE_TABLEBASE;
+            options->tb_pieces = atoi(value);
+            if (options->tb_pieces < 1 || options->tb_pieces > TB_MAX_PIECES)
+            {
+                printf("ERROR: A tablebase covers 1 to %d pieces per side. \n", TB_MAX_PIECES);
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--tb-file") == 0 && value)
+        {
+            options->tb_file = value;
+            options->tb_file_given = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], "--pieces") == 0 && value)
+        {
+            // The limit depends on the board, so it is checked once every option is read.
+            options->pieces = atoi(value);
+            i++;
+        }
+        else if (strcmp(argv[i], "--size") == 0 && value)
+        {
+            options->size = atoi(value);
+            if (options->size < 2 || options->size > WIDE_MAX_SIDE)
+            {
+                printf("ERROR: The board size must be between 2 and %d. \n", WIDE_MAX_SIDE);
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--turns") == 0 && value)
+        {
+            options->turns = atoi(value);
+            if (options->turns < 1)
+            {
+                printf("ERROR: Number of turns cannot be zero. \n");
+                return 0;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && value)
+        {
+            options->seed = strtoull(value, NULL, 10);
+            options->seed_given = 1;
+            i++;
+        }
+        else if ((strcmp(argv[i], "--x-engine") == 0 || strcmp(argv[i], "--o-engine") == 0) && value)
+        {
+            side_specs[argv[i][2] == 'x' ? X_INDEX : O_INDEX] = value;
+            i++;
+        }
+        else {
+            if (strcmp(argv[i], "--help") != 0)
+            {
+                printf("ERROR: Unknown option '%s'. \n", argv[i]);
+            }
+            return 0;
+        }
+    }
+
+    for (int p = 0; p < 2; p++)
+    {
+        options->engines[p] = *engine;
+        if (side_specs[p] && !parseEngineSpec(side_specs[p], &options->engines[p]))
+        {
+            return 0;
+        }
+    }
+    for (int e = 0; e < options->entrant_count; e++)
+    {
+        options->entrants[e] = *engine;
+        if (!parseEngineSpec(entrant_specs[e], &options->entrants[e]))
+        {
+            return 0;
+        }
+    }
+    if (options->pieces < 1 || options->pieces > (options->size * options->size) / 2)
+    {
+        printf("ERROR: Pieces per player must be between 1 and %d. \n", (options->size * options->size) / 2);
+        return 0;
+    }
+    if (options->size != SIDE)
+    {
+        // Everything else is built on the 7x7 bitboards.
+        if (options->mode != MODE_PLAY && options->mode != MODE_SELFPLAY)
+        {
+            printf("ERROR: Only interactive games and self-play can change the board size. \n");
+            return 0;
+        }
+        if (options->ponder || options->record != NULL || options->output == OUTPUT_DIFF)
+        {
+            printf("ERROR: --ponder, --record and --diff need the %dx%d board. \n", SIDE, SIDE);
+            return 0;
+        }
+        if (engine->kind == ENGINE_MCTS || options->engines[X_INDEX].kind == ENGINE_MCTS
+            || options->engines[O_INDEX].kind == ENGINE_MCTS)
+        {
+            printf("ERROR: The mcts engine needs the %dx%d board. \n", SIDE, SIDE);
+            return 0;
+        }
     }
-    else if (score > 0)
+    if (options->mode == MODE_TOURNAMENT && options->entrant_count < 2)
     {
-        // A positive score implies the board state is more favourable for player 'X'
-        printf("NOTE: Score indicates board state is more favourable for player 'X' \n");
+        printf("ERROR: A tournament needs at least two --entrant engines. \n");
+        return 0;
     }
-    else {
-        // Zero score implies that the board state is favourable for both players.
-        printf("NOTE: Score indicates board state is favourable for both players! \n");
+    if (options->sprt && options->entrant_count != 2)
+    {
+        printf("ERROR: The sequential test compares exactly two entrants. \n");
+        return 0;
     }
+    return 1;
 }
 
-// Main entry point of our application.
-int main(int argc, char** argv)
+// Function that tells the user the input ended in the middle of a game.
+int inputEnded(void)
+{
+    printf("\nERROR: The input ended in the middle of a game. \n");
+    return -1;
+}
+
+// Function that greets the user and asks who moves first, the pieces per player and the number of turns,
+// for a board 'side' cells wide. Returns 1 once everything is answered, 0 when the input was over
+// before the first answer and -1 when it ran out part way through.
+int askGameSettings(LineReader* reader, int side, int* first, int* pieces, int* turn_limit)
 {
     // Game title.
-    printf("\t ******** 2D Board Game Between User & Computer ******** \n");
+    printPrompt("\t ******** 2D Board Game Between User & Computer ******** \n");
 
-    // The buffer to store user input.
+    // The line of input being answered.
     char* input = NULL;
-    size_t alloc = 0;
-    // Flag to detect the turn of the user.
-    int turn_user = 0;
     // Flag to detect if the computer is the first player.
     int computer_first = 1;
     // The number of pieces per player.
     int player_pieces = 0;
     // The number of turns in the game.
     int turns = 0;
-    // The array of player symbols.
-    char player_symbol[2] = { PLAYER_ONE, PLAYER_TWO };
-    // The turn count. (Variable to keep track of the turn of the game)
-    int turn_count = 0;
-    // Flag to detect if game is over.
-    int game_over = 0;
-
-    // Seeding the random number generator.
-    srand(time(NULL));
-
-
-    // The 2D array representing the game board is allocated.
-    char** board = (char**)malloc(SIDE * sizeof(char*));
-    for (int i = 0; i < SIDE; i++)
-    {
-        board[i] = (char*)malloc(SIDE);
-    }
     // Asking the user, whether they wanna be the first player.
     while (1)
     {
-        printf("Welcome dear user, \nDo you want to be the first player 'X' (first player) or player 'O' (second player) ? (X/O)\n", player_symbol[0]);
-        getline(&input, &alloc, stdin);
-        if (strlen(input) == 1)
+        printPrompt("Welcome dear user, \nDo you want to be the first player 'X' (first player) or player 'O' (second player) ? (X/O)\n");
+        input = readLine(reader);
+        if (input == NULL)
+        {
+            // The input ran out between two games.
+            return 0;
+        }
+        if (strlen(input) == 0)
         {
             continue;
         }
         else {
-          if (strcasecmp(input, "X\n") == 0 || strcasecmp(input, "x\n") == 0)
+          if (strcasecmp(input, "X") == 0)
           {
-            // The user wants to be the first player.
-            turn_user = 1;
-            // The computer is not the first player.
+            // The user wants to be the first player, so the computer is not the first player.
             computer_first = 0;
             break;
           }else{
-            if(strcasecmp(input, "O\n") != 0 && strcasecmp(input, "o\n") != 0)
+            if(strcasecmp(input, "O") != 0)
             {
-                printf("ERROR: Please provide with 'X' or 'O' as answer! \n");
+                printPrompt("ERROR: Please provide with 'X' or 'O' as answer! \n");
                 continue;
             }else{
                 break;
@@ -545,9 +6483,13 @@ int main(int argc, char** argv)
     // Now ask the user the number of pieces per player.
     while (1)
     {
-        printf("Please, provide the number of pieces per player: \n");
-        getline(&input, &alloc, stdin);
-        if (strlen(input) == 1)
+        printPrompt("Please, provide the number of pieces per player: \n");
+        input = readLine(reader);
+        if (input == NULL)
+        {
+            return inputEnded();
+        }
+        if (strlen(input) == 0)
         {
             continue;
         }
@@ -555,34 +6497,36 @@ int main(int argc, char** argv)
             player_pieces = atoi(input);
             if (player_pieces == 0)
             {
-                printf("Oops! The number of pieces cannot be zero! Please try again!\n");
+                printPrompt("Oops! The number of pieces cannot be zero! Please try again!\n");
                 continue;
             }
 
-            if (player_pieces * 2 > (SIDE * SIDE))
+            if (player_pieces * 2 > (side * side))
             {
-                printf("Oops! Thats too many pieces! Please try again with any positive number less than: %d\n", (SIDE * SIDE) / 2);
+                printPrompt("Oops! Thats too many pieces! Please try again with any positive number less than: %d\n", (side * side) / 2);
                 continue;
             }
             break;
         }
     }
 
-    // The board is initailized randomly.
-    initializeBoard(board, player_pieces);
     /* Next, we need to accept the number of terms from the user. */
     while (1)
     {
-        printf("Please, provide the number of turns: \n");
-        getline(&input, &alloc, stdin);
-        if (strlen(input) == 1)
+        printPrompt("Please, provide the number of turns: \n");
+        input = readLine(reader);
+        if (input == NULL)
+        {
+            return inputEnded();
+        }
+        if (strlen(input) == 0)
         {
             continue;
         }
         else {
             if (atoi(input) == 0)
             {
-                printf("Number of turns cannot be zero. Please try again!\n");
+                printPrompt("Number of turns cannot be zero. Please try again!\n");
                 continue;
             }
             else {
@@ -592,49 +6536,134 @@ int main(int argc, char** argv)
             break;
         }
     }
+    *first = computer_first;
+    *pieces = player_pieces;
+    *turn_limit = turns;
+    return 1;
+}
+
+// Function that plays one game between the user, answering through the reader, and the computer.
+// The game is played in 'session', which keeps its moves for takeback and redo. With 'ponder' set, the
+// computer searches while the user thinks; the caller finishes the pondering when the game returns.
+// A finished game is appended to 'recorder' unless it is NULL.
+// Returns 1 when the game was played to the end, 0 when the input was over before it began
+// and -1 when the input ran out part way through.
+int playInteractiveGame(LineReader* reader, TranspositionTable* tt, const EngineConfig* engine, Random* rng,
+    Session* session, Ponder* ponder, GameRecorder* recorder, RenderBuffer* out)
+{
+    // The line of input being answered.
+    char* input = NULL;
+    // Flag to detect if the computer is the first player.
+    int computer_first = 1;
+    // The number of pieces per player.
+    int player_pieces = 0;
+    // The number of turns in the game.
+    int turns = 0;
+    // The state of the game in play: the board, the side to move and the maintained move counts.
+    GameState* state = &session->state;
+    GameHistory* history = &session->history;
+    // The array of player symbols.
+    char player_symbol[2] = { PLAYER_ONE, PLAYER_TWO };
+    int asked = askGameSettings(reader, SIDE, &computer_first, &player_pieces, &turns);
+    if (asked <= 0)
+    {
+        return asked;
+    }
 
     /* We have received the parameters from the user. */
+    // The board is initailized randomly, and player 'X' always moves first.
+    startSession(session, computer_first ? O_INDEX : X_INDEX, player_pieces, turns, rng);
+    printPrompt("At a move prompt, 'undo' takes back your last move and the computer's reply, and 'redo' plays them again.\n");
+    if (output_mode == OUTPUT_DIFF)
+    {
+        // The board is drawn once; moves only touch the cells they change.
+        renderDiffSetup(out, &state->board);
+    }
 
     // We enter into the game loop.
-    while (turn_count < turns)
+    // First we need to check if the game is over.
+    while (!sessionOver(session))
     {
-        // First we need to check if the game is over.
-        game_over = isGameOver(board, turn_count, computer_first);
-        if (game_over)
+        if (output_mode != OUTPUT_QUIET)
         {
-            break;
+            // The heading of the present turn we are in.
+            renderf(out, "********** TURN: %d ***********\n", session->turn_count + 1);
+            if (output_mode == OUTPUT_NORMAL)
+            {
+                // We render the board for the terminal.
+                renderBoard(out, &state->board);
+                renderf(out, "\n");
+            }
+            // We calculate and display the heuristic score for the present board state.
+            calculateHeuristicScore(out, state);
+            renderf(out, "\n");
         }
-        // The heading of the present turn we are in.
-        printf("********** TURN: %d ***********\n", turn_count + 1);
-        // We print the board to the terminal.
-        printBoard(board);
-        printf("\n");
-        // We calculate and display the heuristic score for the present board state.
-        calculateHeuristicScore(board);
-        printf("\n");
-        if (turn_user)
-        {
-            printf("\n* PLAYER %c's turn *\n\n", player_symbol[computer_first]);
+        // The move made this turn.
+        Move move;
+        if (sessionUserToMove(session))
+        {
+            if (output_mode != OUTPUT_QUIET)
+            {
+                renderf(out, "\n* PLAYER %c's turn *\n\n", player_symbol[computer_first]);
+            }
+            if (ponder)
+            {
+                // The computer thinks on the user's time.
+                startPonder(ponder, tt, state, engine, session->turns - session->turn_count);
+            }
+            // The user needs to see the turn before the prompts.
+            flushRender(out);
             // If it is the user's turn we ask the user to choose their piece, via providing the position.
             // The loop runs till the user provides a valid position.
             // Array to save the player's chosen piece position.
             char player_pos[3] = { 0, 0, 0 };
+            // Set when the user took back or redid a turn instead of moving.
+            int navigated = 0;
             while (1)
             {
-                printf("Dear Player '%c', please enter a piece position you wish to move: ", player_symbol[computer_first]);
-                getline(&input, &alloc, stdin);
-                // getline() inserts the new line character.
-                input[strlen(input) - 1] = 0;
+                printPrompt("Dear Player '%c', please enter a piece position you wish to move: ", player_symbol[computer_first]);
+                input = readLine(reader);
+                if (input == NULL)
+                {
+                    return inputEnded();
+                }
+                if (strcasecmp(input, "undo") == 0 || strcasecmp(input, "redo") == 0)
+                {
+                    // The user's move and the computer's reply go back, or come back, together.
+                    int undo = (tolower((unsigned char)input[0]) == 'u');
+                    if (undo ? history->count < 2 : history->length - history->count < 2)
+                    {
+                        printPrompt(undo ? "There is no move of yours to take back.\n" : "There is no move to redo.\n");
+                        continue;
+                    }
+                    if (ponder)
+                    {
+                        finishPonder(ponder, NULL);
+                    }
+                    undo ? sessionTakeBack(session) : sessionRedo(session);
+                    // The two moves stay in the history either way, just after or just before the present one.
+                    int first = undo ? history->count : history->count - 2;
+                    for (int i = 0; output_mode == OUTPUT_DIFF && i < 2; i++)
+                    {
+                        renderDiffMove(out, &state->board, history->records[first + i].move);
+                    }
+                    if (output_mode != OUTPUT_QUIET)
+                    {
+                        renderf(out, undo ? "\nTook back two moves.\n\n" : "\nPlayed two moves again.\n\n");
+                    }
+                    navigated = 1;
+                    break;
+                }
                 if (strlen(input) != 2)
                 {
-                    printf("Please enter the choice in <row symbol><column number> format, without angle brackets or spaces. \n");
+                    printPrompt("Please enter the choice in <row symbol><column number> format, without angle brackets or spaces. \n");
                     continue;
                 }
 
                 // Now we check the validity of the chosen position.
-                if (!isChosenPositionValid(board, player_symbol[computer_first], input))
+                if (!isChosenPositionValid(&state->board, player_symbol[computer_first], input))
                 {
-                    printf("Oops! Chosen position is unfortunately, invalid. Please try again!\n");
+                    printPrompt("Oops! Chosen position is unfortunately, invalid. Please try again!\n");
                 }
                 else {
                     memcpy(player_pos, input, 2);
@@ -642,23 +6671,32 @@ int main(int argc, char** argv)
                 }
             }
 
+            if (navigated)
+            {
+                // It is the user's turn again, on the board as it was then.
+                flushRender(out);
+                continue;
+            }
+
             // Next we ask the user for a valid move.
             while (1)
             {
-                printf("Dear Player '%c', please enter your new move: ", player_symbol[computer_first]);
-                getline(&input, &alloc, stdin);
-                // getline() inserts the new line character.
-                input[strlen(input) - 1] = 0;
+                printPrompt("Dear Player '%c', please enter your new move: ", player_symbol[computer_first]);
+                input = readLine(reader);
+                if (input == NULL)
+                {
+                    return inputEnded();
+                }
                 if (strlen(input) != 2)
                 {
-                    printf("Please enter the new move in <row symbol><column number> format, without angle brackets or spaces. \n");
+                    printPrompt("Please enter the new move in <row symbol><column number> format, without angle brackets or spaces. \n");
                     continue;
                 }
 
                 // Now we check if the player chose a legal move.
-                if (!isPlayerMoveValid(board, player_symbol[computer_first], player_pos, input))
+                if (!isPlayerMoveValid(&state->board, player_symbol[computer_first], player_pos, input))
                 {
-                    printf("Oops! That was an invalid move! Please try again!\n");
+                    printPrompt("Oops! That was an invalid move! Please try again!\n");
                 }
                 else {
                     // The player move is valid.
@@ -668,155 +6706,552 @@ int main(int argc, char** argv)
             }
 
             // Finally we perform the act of moving the player.
-            int row = tolower(input[0]) - 'a';
-            int col = tolower(input[1]) - '0';
-            board[row][col] = player_symbol[computer_first];
-            // Erasing the old position.
-            board[tolower(player_pos[0]) - 'a'][tolower(player_pos[1]) - '0'] = 0;
-            // We print a message to the terminal.
-            printf("\nPlayer '%c' moves piece from '%s' to '%s'.\n", player_symbol[computer_first], player_pos, input);
-
+            // The old position is erased and the new one is set in one step.
+            move.from = (uint8_t)cellFromString(player_pos);
+            move.to = (uint8_t)cellFromString(input);
+            if (ponder)
+            {
+                finishPonder(ponder, &move);
+            }
+            if (!sessionPlay(session, move))
+            {
+                printf("ERROR: Out of memory for the game history. \n");
+                return -1;
+            }
+            if (output_mode != OUTPUT_QUIET)
+            {
+                // We print a message to the terminal.
+                renderf(out, "\nPlayer '%c' moves piece from '%s' to '%s'.\n", player_symbol[computer_first], player_pos, input);
+            }
         }
         else {
             // This is the computers turn.
-            printf("\n* PLAYER %c's turn (computer's turn) *\n\n", player_symbol[!computer_first]);
-            // First we get a list of positions of the computer's player.
-            char** player_pos = getPlayerPositions(board, player_symbol[!computer_first]);
+            // In quiet mode the messages are rendered but never written.
+            size_t mark = out->length;
+            renderf(out, "\n* PLAYER %c's turn (computer's turn) *\n\n", player_symbol[!computer_first]);
+            int computer = playerIndex(player_symbol[!computer_first]);
+            // The positions of the computer's player.
+            uint64_t player_pos = state->board.pieces[computer];
 
-            // We print the positions of the comnputer's player on the terminal.
-            printf("Player %c's positions: ", player_symbol[!computer_first]);
-            for (char** p = player_pos; *p != NULL; p++)
-            {
-                printf("%s ", *p);
-            }
-            printf("\n");
-            // We iterate through the positions and find the valid moves for that position.
-            // We find the piece that has the maximum moves possible.
+            // We render the positions of the comnputer's player.
+            renderf(out, "Player %c's positions: ", player_symbol[!computer_first]);
+            renderCells(out, player_pos);
+            renderf(out, "\n");
 
-            // The index of the position description that has maximum moves possible!
-            int max_idx = 0;
-            int max = 0;
-            for (char** p = player_pos; *p != NULL; p++)
+            // Near the turn limit only a pondered solve is as good as the move chosen now.
+            int turns_left = session->turns - session->turn_count;
+            if (ponder && ponder->hit && (ponder->result.solved || !endgameSolverApplies(engine, turns_left)))
             {
-                char** valid_moves = getPlayerPieceValidMoves(board, *p);
-                int count = countPosStrings(valid_moves);
-                if(count > max)
-                {
-                    max = count;
-                    max_idx = (p - player_pos);
-                }
-                if(valid_moves)
+                // The move was searched while the user thought.
+                ponder->hit = 0;
+                move = ponder->result.best;
+                renderf(out, "Ponder hit: the reply was ready %.3f s after your move.\n", ponder->latency / 1e9);
+                renderSearchResult(out, engine, &ponder->result);
+            }
+            else {
+                // The engine chooses the move. After a hit whose solve did not finish, the user has already
+                // waited out part of the time budget, so only the rest of it is spent now.
+                EngineConfig budget = *engine;
+                if (ponder && ponder->hit && engine->movetime_ms > 0)
                 {
-                    freeArray(valid_moves);
+                    int waited_ms = (int)(ponder->latency / 1000000u);
+                    budget.movetime_ms = (engine->movetime_ms > waited_ms + 1) ? engine->movetime_ms - waited_ms : 1;
                 }
+                move = chooseComputerMove(out, tt, state, &budget, turns_left, rng);
             }
-
-            // We have found the piece that has maximum valid moves possible!
-            // We enumerate all the valid moves for the piece at that position.
-            char **validMovesToChoose = getPlayerPieceValidMoves(board, player_pos[max_idx]);
-            int count = countPosStrings(validMovesToChoose);
-
-            // The computer randomly chooses a move.
-            int idx = rand() % count;
-            printf("Computer (Player '%c') chooses piece at: '%s' \n", player_symbol[!computer_first], player_pos[max_idx]);
+            char from_pos[3];
+            char to_pos[3];
+            cellToString(move.from, from_pos);
+            cellToString(move.to, to_pos);
+            renderf(out, "Computer (Player '%c') chooses piece at: '%s' \n", player_symbol[!computer_first], from_pos);
             // We perform the movement.
-            char* move = validMovesToChoose[idx];
-            board[tolower(move[0]) - 'a'][tolower(move[1]) - '0'] = player_symbol[!computer_first];
-            // We erase the previous position to simulate the movement.
-            board[tolower(player_pos[max_idx][0]) - 'a'][tolower(player_pos[max_idx][1]) - '0'] = 0;
-            printf("\nComputer (player '%c') moves piece form: '%s' to '%s' \n", player_symbol[!computer_first], player_pos[max_idx],
-                move);
-
-            if(validMovesToChoose)
+            // The previous position is erased along with it to simulate the movement.
+            if (!sessionPlay(session, move))
+            {
+                printf("ERROR: Out of memory for the game history. \n");
+                return -1;
+            }
+            renderf(out, "\nComputer (player '%c') moves piece form: '%s' to '%s' \n", player_symbol[!computer_first], from_pos,
+                to_pos);
+            if (output_mode == OUTPUT_QUIET)
             {
-                freeArray(validMovesToChoose);
+                out->length = mark;
             }
-            freeArray(player_pos);
+        }
+        if (output_mode == OUTPUT_DIFF)
+        {
+            renderDiffMove(out, &state->board, move);
         }
 
-        // This code toggles the turn of the user or computer every iteration.
-        turn_user = !turn_user;
-        // Incrementing the turn count.
-        turn_count++;
-        // To make output clear we add this new line.
-        printf("\n");
+        if (output_mode != OUTPUT_QUIET)
+        {
+            // To make output clear we add this new line.
+            renderf(out, "\n");
+        }
+        // One write per turn.
+        flushRender(out);
     }
 
-    // We print the final board state for verification.
-    printf("******** FINAL STATE ********\n");
-    printBoard(board);
-    printf("\n");
-    if (game_over)
+    if (recorder)
+    {
+        recordSession(recorder, session);
+    }
+
+    // We render the final board state for verification.
+    renderf(out, "******** FINAL STATE ********\n");
+    if (output_mode != OUTPUT_DIFF)
+    {
+        // In diff mode the board at the top of the screen is already final.
+        renderBoard(out, &state->board);
+    }
+    renderf(out, "\n");
+    if (session->game_over)
     {
         // The game is over.
-        printf("!!!!!!!! GAME OVER !!!!!!!!\n");
-        if (turn_user)
+        renderf(out, "!!!!!!!! GAME OVER !!!!!!!!\n");
+        if (sessionUserToMove(session))
         {
             // If it was the user's turn when the game got over,
             // then they lost the game.
-            printf("\nPlayer: '%c' (Computer) won the game! \n\n", player_symbol[!computer_first]);
+            renderf(out, "\nPlayer: '%c' (Computer) won the game! \n\n", player_symbol[!computer_first]);
         }
         else {
             // If it was the computer's turn, then the user won the game.
-            printf("\nPlayer: '%c' (you) won the game! \n\n", player_symbol[computer_first]);
+            renderf(out, "\nPlayer: '%c' (you) won the game! \n\n", player_symbol[computer_first]);
         }
     }
     else {
         // The number of turns got exhausted.
-        printf("!!!!!!!! NO MORE TURNS !!!!!!!!\n");
+        renderf(out, "!!!!!!!! NO MORE TURNS !!!!!!!!\n");
 
         // We compute the number of valid moves each player can make.
-        printf("Computing all valid moves for: '%c'\n", player_symbol[0]);
-        char** all_valid_moves = getPlayerValidMoves(board, player_symbol[0]);
+        renderf(out, "Computing all valid moves for: '%c'\n", player_symbol[0]);
+        MoveList all_valid_moves;
+        generateMoves(&state->board, X_INDEX, &all_valid_moves);
         // Getting the count of such valid moves.
-        int count_a = countPosStrings(all_valid_moves);
-        printf("Player: '%c' has %d valid moves (for each movable piece): ", player_symbol[0], count_a);
+        int count_a = state->mobility[X_INDEX];
+        renderf(out, "Player: '%c' has %d valid moves (for each movable piece): ", player_symbol[0], count_a);
         for (int i = 0; i < count_a; i++)
         {
-            printf("%s ", all_valid_moves[i]);
+            renderCells(out, UINT64_C(1) << all_valid_moves.moves[i].to);
         }
-        freeArray(all_valid_moves);
-        printf("\n\n");
+        renderf(out, "\n\n");
 
-        printf("Computing all valid moves for: '%c'\n", player_symbol[1]);
-        all_valid_moves = getPlayerValidMoves(board, player_symbol[1]);
+        renderf(out, "Computing all valid moves for: '%c'\n", player_symbol[1]);
+        generateMoves(&state->board, O_INDEX, &all_valid_moves);
         // Getting the count of such valid moves.
-        int count_b = countPosStrings(all_valid_moves);
-        printf("Player: '%c' has %d valid moves (for each movable piece): ", player_symbol[1], count_b);
+        int count_b = state->mobility[O_INDEX];
+        renderf(out, "Player: '%c' has %d valid moves (for each movable piece): ", player_symbol[1], count_b);
         for (int i = 0; i < count_b; i++)
         {
-            printf("%s ", all_valid_moves[i]);
+            renderCells(out, UINT64_C(1) << all_valid_moves.moves[i].to);
         }
-        printf("\n\n");
+        renderf(out, "\n\n");
 
         if (count_a == count_b)
         {
-            printf("*** The game is a DRAW *** \n");
+            renderf(out, "*** The game is a DRAW *** \n");
         }
         else {
             if (count_a > count_b)
             {
-                printf("***** The WINNER is player: '%c' ***** \n\n", player_symbol[0]);
+                renderf(out, "***** The WINNER is player: '%c' ***** \n\n", player_symbol[0]);
             }
             else {
-                printf("***** The WINNER is player: '%c' ***** \n\n", player_symbol[1]);
+                renderf(out, "***** The WINNER is player: '%c' ***** \n\n", player_symbol[1]);
             }
         }
     }
+    if (output_mode == OUTPUT_DIFF)
+    {
+        renderDiffTeardown(out);
+    }
+    flushRender(out);
+    return 1;
+}
+
+// Function that checks the user's move of the piece on 'from' to 'to' on a large board.
+int isWideMoveValid(const WideBoard* board, int from, int to)
+{
+    int rows = abs(WIDE_ROW(to) - WIDE_ROW(from));
+    int cols = abs(WIDE_COL(to) - WIDE_COL(from));
+    // Identity moves are not allowed.
+    if (rows + cols == 0)
+    {
+        printf("ERROR: Move cannot be same as the chosen piece position. \n");
+        return 0;
+    }
+    if (rows && cols)
+    {
+        printf("ERROR: Diagonal moves are NOT allowed. \n");
+        return 0;
+    }
+    if (rows + cols > 1)
+    {
+        printf("ERROR: A piece only moves to a neighbouring cell. \n");
+        return 0;
+    }
+    if (widePieceAt(board, to) >= 0)
+    {
+        printf("ERROR: Chosen move position is already occupied! \n");
+        return 0;
+    }
+    return 1;
+}
 
+// Function that renders the destinations of every valid move of a player on a large board.
+void renderWideMoves(RenderBuffer* out, const WideBoard* board, int player)
+{
+    WideMoveList list;
+    generateWideMoves(board, player, &list);
+    for (int i = 0; i < list.count; i++)
+    {
+        char name[WIDE_CELL_TEXT];
+        wideCellToString(list.moves[i].to, name);
+        renderf(out, "%s ", name);
+    }
+}
 
-    /* Freeing the allocated board. */
-    for (int i = 0; i < SIDE; i++)
+// Function that plays one game between the user and the computer on a board 'size' cells wide.
+// It asks and shows what playInteractiveGame() does, without takeback, pondering or recording.
+// Returns 1 when the game was played to the end, 0 when the input was over before it began
+// and -1 when the input ran out part way through.
+int playWideInteractiveGame(LineReader* reader, const EngineConfig* engine, Random* rng, int size, RenderBuffer* out)
+{
+    // The line of input being answered.
+    char* input = NULL;
+    int computer_first = 1;
+    int player_pieces = 0;
+    int turns = 0;
+    char player_symbol[2] = { PLAYER_ONE, PLAYER_TWO };
+    int asked = askGameSettings(reader, size, &computer_first, &player_pieces, &turns);
+    if (asked <= 0)
+    {
+        return asked;
+    }
+
+    // The board is initailized randomly, and player 'X' always moves first.
+    WideBoard board;
+    initWideBoard(&board, size, player_pieces, rng);
+    int user = computer_first ? O_INDEX : X_INDEX;
+    int turn_count = 0;
+    int game_over = 0;
+    while (turn_count < turns && !(game_over = (board.mobility[board.side] == 0)))
+    {
+        if (output_mode != OUTPUT_QUIET)
+        {
+            renderf(out, "********** TURN: %d ***********\n", turn_count + 1);
+            renderWideBoard(out, &board);
+            renderf(out, "\n");
+            renderHeuristicScore(out, board.mobility[X_INDEX] - board.mobility[O_INDEX]);
+            renderf(out, "\n");
+        }
+        WideMove move;
+        char from_pos[WIDE_CELL_TEXT];
+        char to_pos[WIDE_CELL_TEXT];
+        if (board.side == user)
+        {
+            if (output_mode != OUTPUT_QUIET)
+            {
+                renderf(out, "\n* PLAYER %c's turn *\n\n", player_symbol[user]);
+            }
+            flushRender(out);
+            int from;
+            while (1)
+            {
+                printPrompt("Dear Player '%c', please enter a piece position you wish to move: ", player_symbol[user]);
+                input = readLine(reader);
+                if (input == NULL)
+                {
+                    return inputEnded();
+                }
+                from = wideCellFromString(input, size);
+                if (from < 0)
+                {
+                    printPrompt("Please enter the choice in <row letters><column number> format, without angle brackets or spaces. \n");
+                }
+                else if (widePieceAt(&board, from) != user)
+                {
+                    printPrompt("Oops! Chosen position is unfortunately, invalid. Please try again!\n");
+                }
+                else {
+                    break;
+                }
+            }
+            int to;
+            while (1)
+            {
+                printPrompt("Dear Player '%c', please enter your new move: ", player_symbol[user]);
+                input = readLine(reader);
+                if (input == NULL)
+                {
+                    return inputEnded();
+                }
+                to = wideCellFromString(input, size);
+                if (to < 0)
+                {
+                    printPrompt("Please enter the new move in <row letters><column number> format, without angle brackets or spaces. \n");
+                }
+                else if (!isWideMoveValid(&board, from, to))
+                {
+                    printPrompt("Oops! That was an invalid move! Please try again!\n");
+                }
+                else {
+                    break;
+                }
+            }
+            move.from = (uint16_t)from;
+            move.to = (uint16_t)to;
+            wideMakeMove(&board, move);
+            wideCellToString(from, from_pos);
+            wideCellToString(to, to_pos);
+            if (output_mode != OUTPUT_QUIET)
+            {
+                renderf(out, "\nPlayer '%c' moves piece from '%s' to '%s'.\n", player_symbol[user], from_pos, to_pos);
+            }
+        }
+        else {
+            // This is the computers turn.
+            // In quiet mode the messages are rendered but never written.
+            size_t mark = out->length;
+            int computer = !user;
+            renderf(out, "\n* PLAYER %c's turn (computer's turn) *\n\n", player_symbol[computer]);
+            renderf(out, "Player %c's positions: ", player_symbol[computer]);
+            for (int k = 0; k < board.piece_count[computer]; k++)
+            {
+                wideCellToString(board.piece_cells[computer][k], from_pos);
+                renderf(out, "%s ", from_pos);
+            }
+            renderf(out, "\n");
+            SearchResult result;
+            move = chooseWideMove(&board, engine, rng, &result);
+            renderSearchResult(out, engine, &result);
+            wideCellToString(move.from, from_pos);
+            wideCellToString(move.to, to_pos);
+            renderf(out, "Computer (Player '%c') chooses piece at: '%s' \n", player_symbol[computer], from_pos);
+            wideMakeMove(&board, move);
+            renderf(out, "\nComputer (player '%c') moves piece form: '%s' to '%s' \n", player_symbol[computer], from_pos, to_pos);
+            if (output_mode == OUTPUT_QUIET)
+            {
+                out->length = mark;
+            }
+        }
+        turn_count++;
+        PROFILE_TURN();
+        if (output_mode != OUTPUT_QUIET)
+        {
+            renderf(out, "\n");
+        }
+        flushRender(out);
+    }
+
+    renderf(out, "******** FINAL STATE ********\n");
+    renderWideBoard(out, &board);
+    renderf(out, "\n");
+    int winner = decideWideWinner(&board, game_over);
+    if (game_over)
+    {
+        renderf(out, "!!!!!!!! GAME OVER !!!!!!!!\n");
+        renderf(out, "\nPlayer: '%c' (%s) won the game! \n\n", player_symbol[winner], winner == user ? "you" : "Computer");
+    }
+    else {
+        renderf(out, "!!!!!!!! NO MORE TURNS !!!!!!!!\n");
+        for (int p = 0; p < 2; p++)
+        {
+            renderf(out, "Computing all valid moves for: '%c'\n", player_symbol[p]);
+            renderf(out, "Player: '%c' has %d valid moves (for each movable piece): ", player_symbol[p], board.mobility[p]);
+            renderWideMoves(out, &board, p);
+            renderf(out, "\n\n");
+        }
+        if (winner == DRAW)
+        {
+            renderf(out, "*** The game is a DRAW *** \n");
+        }
+        else {
+            renderf(out, "***** The WINNER is player: '%c' ***** \n\n", player_symbol[winner]);
+        }
+    }
+    flushRender(out);
+    return 1;
+}
+
+// Main entry point of our application.
+int main(int argc, char** argv)
+{
+    // The command line options, including the engine that plays the computer's side.
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    EngineConfig engine = options.engine;
+    output_mode = options.output;
+#ifdef XO_PROFILE
+    if (options.profile != NULL && !openProfile(options.profile))
+    {
+        printf("ERROR: Could not create the profile '%s'. \n", options.profile);
+        return 1;
+    }
+#endif
+    initZobrist();
+    if (options.mode == MODE_TABLEBASE)
+    {
+        return !generateTablebase(options.tb_file, options.tb_pieces);
+    }
+    if (options.mode == MODE_REPLAY)
+    {
+        return runReplay(options.replay);
+    }
+    if (options.mode != MODE_BENCH && options.mode != MODE_PERFT)
+    {
+        // Mapping costs nothing up front; pages are read as the search probes them.
+        if (!openTablebase(&tablebase, options.tb_file) && options.tb_file_given)
+        {
+            printf("ERROR: Could not open the tablebase '%s'. \n", options.tb_file);
+            return 1;
+        }
+    }
+    if (options.mode == MODE_SPEEDUP)
+    {
+        runSpeedupTest(&engine);
+        return 0;
+    }
+    if (options.mode == MODE_SELFPLAY)
+    {
+        return runSelfPlay(&options);
+    }
+    if (options.mode == MODE_ANALYZE)
+    {
+        return runAnalysis(&options);
+    }
+    if (options.mode == MODE_SERVER)
+    {
+        return runServer(&options);
+    }
+    if (options.mode == MODE_TOURNAMENT)
     {
-        free(board[i]);
+        return runTournament(&options);
     }
-    free(board);
+    if (options.mode == MODE_BENCH)
+    {
+        return runBenchmarks();
+    }
+    if (options.mode == MODE_PERFT)
+    {
+        runPerft(options.seed, options.pieces, options.perft_depth);
+        return 0;
+    }
+
+    // The transposition table is kept for the whole game, so later moves reuse earlier searches.
+    TranspositionTable tt;
+    if (!ttInit(&tt, engine.hash_mb))
+    {
+        printf("ERROR: Could not allocate a %d MB transposition table. \n", engine.hash_mb);
+        return 1;
+    }
+
+    // Everything shown during a turn is collected here and written in one go.
+    RenderBuffer* out = (RenderBuffer*)malloc(sizeof(RenderBuffer));
+    out->length = 0;
+
+    // The answers to the prompts come from the user, or from a script of recorded answers.
+    FILE* script = stdin;
+    if (options.script != NULL && strcmp(options.script, "-") != 0)
+    {
+        script = fopen(options.script, "rb");
+        if (script == NULL)
+        {
+            printf("ERROR: Could not open the script '%s'. \n", options.script);
+            ttFree(&tt);
+            free(out);
+            return 1;
+        }
+    }
+    LineReader reader;
+    initLineReader(&reader, script, options.script == NULL);
+    // The game in play, with its moves for takeback and redo.
+    Session session;
+    initSession(&session);
+    // The background search on the user's time, when asked for.
+    Ponder ponder;
+    memset(&ponder, 0, sizeof(ponder));
+    Ponder* pondering = options.ponder ? &ponder : NULL;
+    // The archive of finished games, when asked for.
+    GameRecorder recorder;
+    GameRecorder* recording = NULL;
+    if (options.record != NULL)
+    {
+        if (!openRecorder(&recorder, options.record))
+        {
+            printf("ERROR: Could not open the game archive '%s'. \n", options.record);
+            freeLineReader(&reader);
+            freeSession(&session);
+            if (script != stdin)
+            {
+                fclose(script);
+            }
+            ttFree(&tt);
+            free(out);
+            return 1;
+        }
+        recording = &recorder;
+    }
+
+    // Seeding the random number generator. A script always uses --seed (1 by default), so the
+    // boards, and with them the recorded answers, are the same on every replay.
+    Random rng;
+    uint64_t seed = (options.seed_given || options.script != NULL) ? options.seed : clockSeed();
+    seedRandom(&rng, seed);
 
-    if (!input)
+    int status = 0;
+    if (options.script == NULL)
     {
-        free(input);
+        // The seed is shown so that a game can be set up again with --seed.
+        printPrompt("Board seed: %llu\n", (unsigned long long)seed);
+        int result = (options.size == SIDE)
+            ? playInteractiveGame(&reader, &tt, &engine, &rng, &session, pondering, recording, out)
+            : playWideInteractiveGame(&reader, &engine, &rng, options.size, out);
+        if (result < 0)
+        {
+            status = 1;
+        }
+        finishPonder(&ponder, NULL);
+        system("pause");
+    }
+    else {
+        // A script plays game after game until it runs out.
+        flush_each_turn = 0;
+        int games = 0;
+        uint64_t start = nowNanoseconds();
+        int result;
+        while ((result = (options.size == SIDE)
+            ? playInteractiveGame(&reader, &tt, &engine, &rng, &session, pondering, recording, out)
+            : playWideInteractiveGame(&reader, &engine, &rng, options.size, out)) > 0)
+        {
+            finishPonder(&ponder, NULL);
+            games++;
+            // Every game starts from an empty table, as it would in a fresh run.
+            ttClear(&tt);
+        }
+        double seconds = (nowNanoseconds() - start) / 1e9;
+        printf("Played %d scripted games in %.3f s (%.1f games/sec)\n", games, seconds, seconds > 0 ? games / seconds : 0.0);
+        finishPonder(&ponder, NULL);
+        status = (result < 0) ? 1 : 0;
     }
 
-    system("pause");
-    return 0;
+    if (recording && !closeRecorder(recording))
+    {
+        printf("ERROR: Could not write the game archive '%s'. \n", options.record);
+        status = 1;
+    }
+    freeLineReader(&reader);
+    freeSession(&session);
+    if (script != stdin)
+    {
+        fclose(script);
+    }
+    ttFree(&tt);
+    free(out);
+    return status;
 }